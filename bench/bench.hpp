@@ -0,0 +1,267 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Small utilities shared by the benchmark programs: command-line options,
+// timing, memory usage and JSON output.
+
+#ifndef INCLUDED_SNSINFU_BENCH_HPP
+#define INCLUDED_SNSINFU_BENCH_HPP
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/resource.h>
+
+
+namespace bench
+{
+    // Options given as `--name=value` on the command line.
+    class options
+    {
+    public:
+        options(int argc, char** argv)
+        {
+            for (int i = 1; i < argc; i++) {
+                std::string const arg = argv[i];
+                auto const eq = arg.find('=');
+
+                if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+                    throw std::invalid_argument{"expected --name=value: " + arg};
+                }
+                _values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+
+        double
+        number(std::string const& name, double default_value) const
+        {
+            auto const it = _values.find(name);
+            if (it == _values.end()) {
+                return default_value;
+            }
+            return std::strtod(it->second.c_str(), nullptr);
+        }
+
+        std::string
+        text(std::string const& name, std::string const& default_value) const
+        {
+            auto const it = _values.find(name);
+            return it == _values.end() ? default_value : it->second;
+        }
+
+        // Returns a comma-separated list of numbers.
+        std::vector<double>
+        numbers(std::string const& name, std::string const& default_value) const
+        {
+            std::vector<double> values;
+            for (auto const& item : list(name, default_value)) {
+                values.push_back(std::strtod(item.c_str(), nullptr));
+            }
+            return values;
+        }
+
+        // Returns a comma-separated list.
+        std::vector<std::string>
+        list(std::string const& name, std::string const& default_value) const
+        {
+            auto const it = _values.find(name);
+            std::istringstream stream{it == _values.end() ? default_value : it->second};
+            std::vector<std::string> items;
+            for (std::string item; std::getline(stream, item, ','); ) {
+                items.push_back(item);
+            }
+            return items;
+        }
+
+    private:
+        std::map<std::string, std::string> _values;
+    };
+
+
+    // Returns seconds elapsed while running `fn()`.
+    template<typename F>
+    double
+    time(F fn)
+    {
+        using clock = std::chrono::steady_clock;
+        using seconds = std::chrono::duration<double>;
+
+        auto const start = clock::now();
+        fn();
+        auto const end = clock::now();
+
+        return seconds(end - start).count();
+    }
+
+
+    // Keeps a computed value alive so that the compiler does not remove the
+    // computation.
+    template<typename T>
+    void
+    keep(T const& value)
+    {
+        static T volatile sink;
+        sink = value;
+        static_cast<void>(sink);
+    }
+
+
+    // Returns the peak resident set size of the process in bytes.
+    inline double
+    peak_rss()
+    {
+        ::rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) == -1) {
+            return 0;
+        }
+#ifdef __APPLE__
+        return double(usage.ru_maxrss);
+#else
+        return double(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+
+    // Resets the peak resident set size to the current one so that the
+    // next `peak_rss()` reflects only subsequent allocations. Works on
+    // Linux 4.0 and later; returns false if unsupported.
+    inline bool
+    reset_peak_rss()
+    {
+        std::ofstream clear_refs{"/proc/self/clear_refs"};
+        clear_refs << "5";
+        clear_refs.flush();
+        return bool(clear_refs);
+    }
+
+
+    // JSON object built field by field.
+    class record
+    {
+    public:
+        record&
+        field(std::string const& name, std::string const& value)
+        {
+            std::string quoted = "\"";
+            for (auto const ch : value) {
+                if (ch == '"' || ch == '\\') {
+                    quoted += '\\';
+                }
+                quoted += ch;
+            }
+            quoted += '"';
+            return raw(name, quoted);
+        }
+
+        record&
+        field(std::string const& name, char const* value)
+        {
+            return field(name, std::string{value});
+        }
+
+        template<
+            typename T,
+            typename = typename std::enable_if<std::is_integral<T>::value>::type
+        >
+        record&
+        field(std::string const& name, T value)
+        {
+            return raw(name, std::to_string(value));
+        }
+
+        // Infinities and NaNs, e.g. rates of runs that took no time, are
+        // written as null since JSON has no literals for them.
+        record&
+        field(std::string const& name, double value)
+        {
+            if (!std::isfinite(value)) {
+                return raw(name, "null");
+            }
+            char buf[32];
+            std::snprintf(buf, sizeof buf, "%.6g", value);
+            return raw(name, buf);
+        }
+
+        std::string
+        str() const
+        {
+            return "{" + _fields + "}";
+        }
+
+    private:
+        record&
+        raw(std::string const& name, std::string const& value)
+        {
+            if (!_fields.empty()) {
+                _fields += ", ";
+            }
+            _fields += "\"" + name + "\": " + value;
+            return *this;
+        }
+
+        std::string _fields;
+    };
+
+
+    // Writes records as a JSON document of the form
+    //
+    //   {"benchmark": "<name>", "results": [<record>, ...]}
+    //
+    // to a file, or to stdout if the path is empty. Records are written as
+    // they are added so that partial results survive an interrupted run.
+    class report
+    {
+    public:
+        explicit report(std::string const& name, std::string const& path = "")
+        {
+            if (!path.empty()) {
+                _file.open(path);
+                if (!_file) {
+                    throw std::runtime_error{"cannot open " + path};
+                }
+            }
+            out() << "{\"benchmark\": \"" << name << "\", \"results\": [";
+            out().flush();
+        }
+
+        ~report()
+        {
+            out() << "\n]}\n";
+        }
+
+        report(report const&) = delete;
+        report& operator=(report const&) = delete;
+
+        void
+        add(record const& rec)
+        {
+            out() << (_empty ? "\n  " : ",\n  ") << rec.str();
+            out().flush();
+            _empty = false;
+        }
+
+    private:
+        std::ostream&
+        out()
+        {
+            return _file.is_open() ? _file : std::cout;
+        }
+
+        std::ofstream _file;
+        bool _empty = true;
+    };
+}
+
+#endif
@@ -0,0 +1,186 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Hardware counters per `find` and `update` of the tree implementations:
+// cycles, instructions, branch misses, L1D, LLC and data TLB misses per
+// operation, measured with perf_event_open (see perf.hpp).
+//
+// Usage: ./bench_counters [--name=value ...]
+//
+//   --sizes=1e3,1e4,1e5,1e6,1e7
+//                       Numbers of events.
+//   --ops=1e6           Number of operations per measurement.
+//   --impls=sumtree,atomic,seqlock
+//   --output=FILE       Output file. Defaults to stdout.
+//
+// The implementations are cxx::discrete_weights (sumtree),
+// cxx::atomic_discrete_weights (atomic) and
+// cxx::concurrent_discrete_distribution (seqlock). All weights are one.
+//
+// Results are written as JSON. Each record has the fields impl, n, op, ops
+// and ns_per_op, plus `<event>_per_op` for each available counter. The
+// record with op "baseline" measures the loop and random number generation
+// alone, which are included in the other records. Counters that cannot be
+// opened, as is common in containers, are listed on stderr and left out of
+// the records; wall times are reported regardless.
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <atomic_discrete_weights.hpp>
+#include <concurrent_discrete_distribution.hpp>
+#include <discrete_distribution.hpp>
+
+#include "bench.hpp"
+#include "perf.hpp"
+
+
+namespace
+{
+    // Random numbers are generated inline with SplitMix64 instead of being
+    // read from a pregenerated array, so that the cache and TLB misses
+    // counted are those of the tree.
+    class splitmix64
+    {
+    public:
+        std::uint64_t
+        operator()()
+        {
+            std::uint64_t z = (_state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        double
+        uniform(double max)
+        {
+            return double(operator()() >> 11) * (1.0 / 9007199254740992.0) * max;
+        }
+
+    private:
+        std::uint64_t _state = 0;
+    };
+
+
+    struct context
+    {
+        bench::report& report;
+        bench::perf_counters& counters;
+        std::size_t ops;
+    };
+
+
+    template<typename F>
+    void
+    measure(context const& ctx, char const* impl, std::size_t n, char const* op, F fn)
+    {
+        double seconds = 0;
+        auto const counts = bench::count(ctx.counters, [&] {
+            seconds = bench::time(fn);
+        });
+
+        auto const ops = double(ctx.ops);
+        bench::record rec;
+        rec.field("impl", impl)
+           .field("n", n)
+           .field("op", op)
+           .field("ops", ctx.ops)
+           .field("ns_per_op", seconds / ops * 1e9);
+        for (auto const& count : counts) {
+            rec.field(count.first + "_per_op", count.second / ops);
+        }
+        ctx.report.add(rec);
+    }
+
+
+    // Measures `find` and `update` of a tree with the interface of
+    // discrete_weights.
+    template<typename Tree>
+    void
+    bench_tree(context const& ctx, char const* impl, std::size_t n, Tree& tree)
+    {
+        auto const sum = tree.sum();
+
+        measure(ctx, impl, n, "find", [&] {
+            splitmix64 random;
+            std::size_t result = 0;
+            for (std::size_t k = 0; k < ctx.ops; k++) {
+                result += tree.find(random.uniform(sum));
+            }
+            bench::keep(result);
+        });
+
+        measure(ctx, impl, n, "update", [&] {
+            splitmix64 random;
+            for (std::size_t k = 0; k < ctx.ops; k++) {
+                auto const i = std::size_t(random() % n);
+                tree.update(i, 0.5 + random.uniform(1.0));
+            }
+        });
+    }
+
+
+    void
+    bench_baseline(context const& ctx)
+    {
+        measure(ctx, "none", 0, "baseline", [&] {
+            splitmix64 random;
+            double result = 0;
+            for (std::size_t k = 0; k < ctx.ops; k++) {
+                result += random.uniform(1.0);
+            }
+            bench::keep(result);
+        });
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bench::options const opts{argc, argv};
+
+    auto const sizes = opts.numbers("sizes", "1e3,1e4,1e5,1e6,1e7");
+    auto const ops = std::size_t(opts.number("ops", 1e6));
+    auto const impls = opts.list("impls", "sumtree,atomic,seqlock");
+
+    bench::perf_counters counters;
+    for (auto const& event : counters.unavailable()) {
+        std::cerr << "counter " << event.first << " unavailable: " << event.second << '\n';
+    }
+    if (!counters.available()) {
+        std::cerr << "no hardware counters available; reporting wall time only\n";
+    }
+
+    bench::report report{"counters", opts.text("output", "")};
+    context const ctx{report, counters, ops};
+
+    bench_baseline(ctx);
+
+    for (auto const size : sizes) {
+        auto const n = std::size_t(size);
+        std::vector<double> const weights(n, 1.0);
+
+        for (auto const& impl : impls) {
+            if (impl == "sumtree") {
+                cxx::discrete_weights tree{weights};
+                bench_tree(ctx, "sumtree", n, tree);
+            } else if (impl == "atomic") {
+                cxx::atomic_discrete_weights tree{weights};
+                bench_tree(ctx, "atomic", n, tree);
+            } else if (impl == "seqlock") {
+                cxx::concurrent_discrete_distribution<std::size_t> tree{weights};
+                bench_tree(ctx, "seqlock", n, tree);
+            } else {
+                std::cerr << "unknown impl: " << impl << '\n';
+                return 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,343 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Micro-benchmark of cxx::discrete_weights and cxx::discrete_distribution
+// against std::discrete_distribution.
+//
+// Usage: ./bench_discrete_weights [--name=value ...]
+//
+//   --min_n=10          Smallest number of events.
+//   --max_n=1e7         Largest number of events. Sizes are powers of ten.
+//                       1e9 needs about 24 GB of memory.
+//   --std_max_n=1e6     Largest number of events for std.
+//   --ops=1e6           Number of operations per measurement.
+//   --profiles=uniform,zipf,sparse
+//   --output=FILE       Output file. Defaults to stdout.
+//
+// Results are written as JSON. Each record has the fields impl,
+// profile, n, op, ops and ns_per_op. The ops are:
+//
+//   construct       Building from a vector of weights. ns_per_op is per
+//                   construction.
+//   update          Changing the weight of a random event.
+//   find            Looking up a random probe value (cxx only).
+//   sample          Drawing a random event.
+//   mixed_U:S       Rounds of U updates followed by S samples. ns_per_op is
+//                   per update or sample. std rebuilds once per round.
+//
+// Events, update factors and probes are generated inline with SplitMix64,
+// so every event of the tree can be touched at any N. The timings of update
+// and find include the generator, which costs a few nanoseconds.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <discrete_distribution.hpp>
+
+#include "bench.hpp"
+
+
+namespace
+{
+    // Generator of random inputs. It is cheap enough to run inline, unlike
+    // std::mt19937_64 with a distribution, and touches no memory, unlike a
+    // pregenerated array that would warm only part of a large tree.
+    class splitmix64
+    {
+    public:
+        std::uint64_t
+        operator()()
+        {
+            std::uint64_t z = (_state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        double
+        uniform(double max)
+        {
+            return double(operator()() >> 11) * (1.0 / 9007199254740992.0) * max;
+        }
+
+    private:
+        std::uint64_t _state = 0;
+    };
+
+
+    // Updates scale the original weight of an event by a random factor in
+    // [0.5, 1.5) so that the profile is preserved.
+    double
+    random_factor(splitmix64& random)
+    {
+        return 0.5 + random.uniform(1.0);
+    }
+
+
+    std::vector<double>
+    make_weights(std::string const& profile, std::size_t n, std::mt19937_64& random)
+    {
+        std::vector<double> weights(n, 1.0);
+
+        if (profile == "zipf") {
+            for (std::size_t i = 0; i < n; i++) {
+                weights[i] = 1.0 / double(i + 1);
+            }
+        } else if (profile == "sparse") {
+            std::bernoulli_distribution nonzero{0.01};
+            for (auto& w : weights) {
+                w = nonzero(random) ? 1.0 : 0.0;
+            }
+            weights[n / 2] = 1.0;
+        } else if (profile != "uniform") {
+            throw std::invalid_argument{"unknown profile: " + profile};
+        }
+
+        return weights;
+    }
+
+
+    struct context
+    {
+        bench::report& report;
+        std::string profile;
+        std::size_t n;
+        double sum;
+    };
+
+
+    void
+    emit(
+        context const& ctx,
+        char const* impl,
+        std::string const& op,
+        std::size_t ops,
+        double seconds
+    )
+    {
+        ctx.report.add(
+            bench::record{}
+                .field("impl", impl)
+                .field("profile", ctx.profile)
+                .field("n", ctx.n)
+                .field("op", op)
+                .field("ops", ops)
+                .field("ns_per_op", seconds / double(ops) * 1e9)
+        );
+    }
+
+
+    void
+    bench_cxx(
+        context const& ctx,
+        std::vector<double> const& weights,
+        std::size_t ops
+    )
+    {
+
+        auto const constructs = std::max<std::size_t>(1, ops / ctx.n);
+        auto const construct_time = bench::time([&] {
+            for (std::size_t k = 0; k < constructs; k++) {
+                cxx::discrete_weights tree{weights};
+                bench::keep(tree.sum());
+            }
+        });
+        emit(ctx, "cxx", "construct", constructs, construct_time);
+
+        cxx::discrete_weights tree{weights};
+
+        auto const find_time = bench::time([&] {
+            splitmix64 random;
+            std::size_t sum = 0;
+            for (std::size_t k = 0; k < ops; k++) {
+                sum += tree.find(random.uniform(ctx.sum));
+            }
+            bench::keep(sum);
+        });
+        emit(ctx, "cxx", "find", ops, find_time);
+
+        auto const update_time = bench::time([&] {
+            splitmix64 random;
+            for (std::size_t k = 0; k < ops; k++) {
+                auto const i = std::size_t(random() % ctx.n);
+                tree.update(i, weights[i] * random_factor(random));
+            }
+        });
+        emit(ctx, "cxx", "update", ops, update_time);
+
+        cxx::discrete_distribution<std::size_t> distr{weights};
+        std::mt19937_64 random;
+
+        auto const sample_time = bench::time([&] {
+            std::size_t sum = 0;
+            for (std::size_t k = 0; k < ops; k++) {
+                sum += distr(random);
+            }
+            bench::keep(sum);
+        });
+        emit(ctx, "cxx", "sample", ops, sample_time);
+
+        std::size_t const ratios[][2] = {{1, 10}, {1, 1}, {10, 1}};
+
+        for (auto const& ratio : ratios) {
+            auto const rounds = std::max<std::size_t>(1, ops / (ratio[0] + ratio[1]));
+            auto const mixed_time = bench::time([&] {
+                splitmix64 inputs;
+                std::size_t sum = 0;
+                for (std::size_t round = 0; round < rounds; round++) {
+                    for (std::size_t u = 0; u < ratio[0]; u++) {
+                        auto const i = std::size_t(inputs() % ctx.n);
+                        distr.update(i, weights[i] * random_factor(inputs));
+                    }
+                    for (std::size_t s = 0; s < ratio[1]; s++) {
+                        sum += distr(random);
+                    }
+                }
+                bench::keep(sum);
+            });
+
+            auto const op = "mixed_" + std::to_string(ratio[0]) + ":" + std::to_string(ratio[1]);
+            emit(ctx, "cxx", op, rounds * (ratio[0] + ratio[1]), mixed_time);
+        }
+    }
+
+
+    void
+    bench_std(
+        context const& ctx,
+        std::vector<double> const& weights,
+        std::size_t ops
+    )
+    {
+
+        // Updates rebuild the distribution in O(N), so limit their number.
+        auto const rebuilds = std::max<std::size_t>(10, std::min<std::size_t>(ops, 100000000 / ctx.n));
+
+        auto const constructs = std::max<std::size_t>(1, ops / ctx.n);
+        auto const construct_time = bench::time([&] {
+            for (std::size_t k = 0; k < constructs; k++) {
+                std::discrete_distribution<std::size_t> distr{weights.begin(), weights.end()};
+                bench::keep(distr.max());
+            }
+        });
+        emit(ctx, "std", "construct", constructs, construct_time);
+
+        auto current = weights;
+        auto const update_time = bench::time([&] {
+            splitmix64 random;
+            for (std::size_t k = 0; k < rebuilds; k++) {
+                auto const i = std::size_t(random() % ctx.n);
+                current[i] = weights[i] * random_factor(random);
+                std::discrete_distribution<std::size_t> distr{current.begin(), current.end()};
+                bench::keep(distr.max());
+            }
+        });
+        emit(ctx, "std", "update", rebuilds, update_time);
+
+        std::discrete_distribution<std::size_t> distr{weights.begin(), weights.end()};
+        std::mt19937_64 random;
+
+        auto const sample_time = bench::time([&] {
+            std::size_t sum = 0;
+            for (std::size_t k = 0; k < ops; k++) {
+                sum += distr(random);
+            }
+            bench::keep(sum);
+        });
+        emit(ctx, "std", "sample", ops, sample_time);
+
+        std::size_t const ratios[][2] = {{1, 10}, {1, 1}, {10, 1}};
+
+        for (auto const& ratio : ratios) {
+            auto const rounds = std::max<std::size_t>(
+                1, std::min(ops / (ratio[0] + ratio[1]), rebuilds)
+            );
+            current = weights;
+
+            auto const mixed_time = bench::time([&] {
+                splitmix64 inputs;
+                std::size_t sum = 0;
+                for (std::size_t round = 0; round < rounds; round++) {
+                    for (std::size_t u = 0; u < ratio[0]; u++) {
+                        auto const i = std::size_t(inputs() % ctx.n);
+                        current[i] = weights[i] * random_factor(inputs);
+                    }
+                    distr.param({current.begin(), current.end()});
+                    for (std::size_t s = 0; s < ratio[1]; s++) {
+                        sum += distr(random);
+                    }
+                }
+                bench::keep(sum);
+            });
+
+            auto const op = "mixed_" + std::to_string(ratio[0]) + ":" + std::to_string(ratio[1]);
+            emit(ctx, "std", op, rounds * (ratio[0] + ratio[1]), mixed_time);
+        }
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bench::options const options{argc, argv};
+
+    auto const min_n = options.number("min_n", 10);
+    auto const max_n = options.number("max_n", 1e7);
+    auto const std_max_n = options.number("std_max_n", 1e6);
+    auto const ops = options.number("ops", 1e6);
+    auto const profiles = options.list("profiles", "uniform,zipf,sparse");
+
+    // Validate everything up front so that a bad sweep fails before any
+    // measurement. The upper limit keeps the sizes, including the one past
+    // max_n that ends the sweep, representable.
+    double const limit = 1e15;
+
+    if (!(min_n >= 1) || !(min_n <= max_n) || !(max_n <= limit)) {
+        std::cerr << "sizes must satisfy 1 <= min_n <= max_n <= " << limit << '\n';
+        return 1;
+    }
+    if (!(std_max_n >= 0) || !(std_max_n <= limit)) {
+        std::cerr << "std_max_n must be between 0 and " << limit << '\n';
+        return 1;
+    }
+    if (!(ops >= 1) || !(ops <= limit)) {
+        std::cerr << "ops must be between 1 and " << limit << '\n';
+        return 1;
+    }
+    for (auto const& profile : profiles) {
+        if (profile != "uniform" && profile != "zipf" && profile != "sparse") {
+            std::cerr << "unknown profile: " << profile << '\n';
+            return 1;
+        }
+    }
+
+    bench::report report{"discrete_weights", options.text("output", "")};
+
+    for (auto const& profile : profiles) {
+        for (auto n = std::size_t(min_n); n <= std::size_t(max_n); n *= 10) {
+            std::mt19937_64 random;
+
+            auto const weights = make_weights(profile, n, random);
+            double sum = 0;
+            for (auto const w : weights) {
+                sum += w;
+            }
+
+            context const ctx{report, profile, n, sum};
+
+            bench_cxx(ctx, weights, std::size_t(ops));
+
+            if (n <= std::size_t(std_max_n)) {
+                bench_std(ctx, weights, std::size_t(ops));
+            }
+        }
+    }
+}
@@ -0,0 +1,331 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// End-to-end benchmark of the Gillespie simulators of ssa.hpp. The workloads
+// are parameterized versions of the example programs, built as
+// cxx::ssa::reaction_network:
+//
+//   ring       Circular network of example/gillespie. Each step changes
+//              the propensities of two reactions.
+//   catalytic  Random catalytic network R + C --> P + C of
+//              example/random_network. Each step changes about
+//              4 * reactions / species propensities.
+//
+// Usage: ./bench_ssa [--name=value ...]
+//
+//   --ring_species=1e3,1e4,1e5,1e6   Sizes of the ring network.
+//   --reactions=1e4,1e5,1e6          Reaction counts of the catalytic network.
+//   --densities=1,10,100             Reactions per species of the catalytic
+//                                    network. Must leave at least two species.
+//   --steps=1e5                      Maximum steps per simulation.
+//   --workloads=ring,catalytic
+//   --engines=direct,next_reaction
+//   --output=FILE                    Output file. Defaults to stdout.
+//
+// The engines are cxx::ssa::direct_engine (direct) and
+// cxx::ssa::next_reaction_engine (next_reaction). Each configuration is
+// simulated with every engine from the same network, initial counts and
+// seed. Each result record has the fields workload, engine, species,
+// reactions, density, steps, steps_per_sec, ns_per_step, setup_sec,
+// peak_rss_mb and peak_rss_scope. setup_sec is the time taken to construct
+// the engine. peak_rss_mb is the peak memory used by the configuration if
+// the system allows resetting the peak (peak_rss_scope is "configuration"),
+// and the peak of the process so far otherwise (peak_rss_scope is
+// "process").
+//
+// bench_ssa_stats is this program built with DISTR_STATS. It splits the
+// step time of the direct engine into the propensity tree operations and
+// adds the fields updates_per_step, ns_per_update and ns_per_sample. The
+// latter two are the mean latencies of discrete_weights::update and
+// discrete_weights::find timed on sampled calls, less the mean cost of
+// reading the clock. The instrumentation slows down the steps, so take the
+// other timings from bench_ssa.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <ssa.hpp>
+
+#include "bench.hpp"
+
+
+namespace
+{
+    // Reaction network and initial species counts of a workload.
+    struct model
+    {
+        cxx::ssa::reaction_network network;
+        std::vector<cxx::ssa::count_type> counts;
+    };
+
+
+    // Network of example/gillespie: reaction i converts species i into
+    // species i + 1 (mod N).
+    model
+    make_ring_model(std::size_t num_species)
+    {
+        double const rate = 0.1;
+
+        model ring;
+        ring.network = cxx::ssa::reaction_network{num_species};
+        ring.counts.resize(num_species);
+
+        for (std::size_t i = 0; i < num_species; i++) {
+            ring.network.add_reaction(rate, {{i, 1}}, {{(i + 1) % num_species, 1}});
+        }
+
+        // Spread molecules so that many reactions are active.
+        for (std::size_t i = 0; i < num_species; i += 10) {
+            ring.counts[i] = 5;
+        }
+
+        return ring;
+    }
+
+
+    // Network of example/random_network. Requires at least two species so
+    // that a reactant and a distinct catalyst can be chosen.
+    model
+    make_catalytic_model(std::size_t num_species, std::size_t num_reactions, std::mt19937_64& random)
+    {
+        model catalytic;
+        catalytic.network = cxx::ssa::reaction_network{num_species};
+
+        while (catalytic.counts.size() < num_species) {
+            std::poisson_distribution<cxx::ssa::count_type> count;
+            catalytic.counts.push_back(1 + count(random));
+        }
+
+        while (catalytic.network.reactions() < num_reactions) {
+            std::uniform_int_distribution<std::size_t> species{0, num_species - 1};
+            std::lognormal_distribution<double> base_rate;
+
+            auto const reactant = species(random);
+            auto const catalyst = species(random);
+            auto const product = species(random);
+            auto const rate = base_rate(random);
+
+            if (reactant == catalyst) {
+                continue;
+            }
+
+            catalytic.network.add_reaction(
+                rate,
+                {{reactant, 1}, {catalyst, 1}},
+                {{product, 1}, {catalyst, 1}}
+            );
+        }
+
+        return catalytic;
+    }
+
+
+    // Adds the breakdown of the step time. Only the direct engine uses an
+    // instrumented propensity tree.
+    template<typename Engine>
+    void
+    add_breakdown(bench::record&, Engine const&)
+    {
+    }
+
+
+#ifdef DISTR_STATS
+    // Returns the mean latency recorded for an empty operation, i.e., the
+    // cost of the two clock reads around each timed call.
+    double
+    clock_overhead()
+    {
+        using clock = std::chrono::steady_clock;
+
+        cxx::latency_histogram histogram;
+        for (int i = 0; i < 100000; i++) {
+            auto const start = clock::now();
+            auto const elapsed = clock::now() - start;
+            histogram.record(std::uint64_t(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+            ));
+        }
+        return histogram.mean();
+    }
+
+
+    template<typename RNG>
+    void
+    add_breakdown(bench::record& record, cxx::ssa::direct_engine<RNG> const& engine)
+    {
+        static double const overhead = clock_overhead();
+
+        auto const& stats = engine.propensities().stats();
+        record
+            .field("updates_per_step", double(stats.updates) / double(engine.steps()))
+            .field("ns_per_update", stats.update_latency.mean() - overhead)
+            .field("ns_per_sample", stats.find_latency.mean() - overhead);
+    }
+#endif
+
+
+    struct configuration
+    {
+        std::string workload;
+        std::size_t species;
+        std::size_t reactions;
+    };
+
+
+    // Constructs an engine for the model and runs it for at most
+    // `max_steps` steps.
+    template<typename Engine>
+    void
+    measure(
+        bench::report& report,
+        configuration const& config,
+        char const* engine_name,
+        model const& source,
+        long max_steps
+    )
+    {
+        using clock = std::chrono::steady_clock;
+
+        auto const rss_reset = bench::reset_peak_rss();
+
+        auto const setup_start = clock::now();
+        Engine engine{source.network, source.counts};
+        auto const setup_seconds =
+            std::chrono::duration<double>(clock::now() - setup_start).count();
+
+        auto const seconds = bench::time([&] {
+            for (long step = 0; step < max_steps; step++) {
+                if (!engine.step()) {
+                    break;
+                }
+            }
+        });
+        bench::keep(engine.time());
+
+        auto const peak_rss = bench::peak_rss();
+        auto const steps = double(engine.steps());
+
+        bench::record record;
+        record
+            .field("workload", config.workload)
+            .field("engine", engine_name)
+            .field("species", config.species)
+            .field("reactions", config.reactions)
+            .field("density", double(config.reactions) / double(config.species))
+            .field("steps", engine.steps())
+            .field("steps_per_sec", steps / seconds)
+            .field("ns_per_step", seconds / steps * 1e9)
+            .field("setup_sec", setup_seconds)
+            .field("peak_rss_mb", peak_rss / 1e6)
+            .field("peak_rss_scope", rss_reset ? "configuration" : "process");
+        add_breakdown(record, engine);
+
+        report.add(record);
+    }
+
+
+    // Runs the model with each requested engine.
+    void
+    measure_engines(
+        bench::report& report,
+        configuration const& config,
+        std::vector<std::string> const& engines,
+        model const& source,
+        long max_steps
+    )
+    {
+        for (auto const& engine : engines) {
+            if (engine == "direct") {
+                measure<cxx::ssa::direct_engine<>>(
+                    report, config, "direct", source, max_steps
+                );
+            } else {
+                measure<cxx::ssa::next_reaction_engine<>>(
+                    report, config, "next_reaction", source, max_steps
+                );
+            }
+        }
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    bench::options const options{argc, argv};
+
+    auto const ring_species = options.numbers("ring_species", "1e3,1e4,1e5,1e6");
+    auto const reaction_counts = options.numbers("reactions", "1e4,1e5,1e6");
+    auto const densities = options.numbers("densities", "1,10,100");
+    auto const max_steps = long(options.number("steps", 1e5));
+    auto const workloads = options.list("workloads", "ring,catalytic");
+    auto const engines = options.list("engines", "direct,next_reaction");
+
+    // Validate everything up front so that a bad sweep fails before any
+    // measurement instead of partway through (or, for the catalytic network
+    // with fewer than two species, never).
+    for (auto const& workload : workloads) {
+        if (workload != "ring" && workload != "catalytic") {
+            std::cerr << "unknown workload: " << workload << '\n';
+            return 1;
+        }
+    }
+    for (auto const& engine : engines) {
+        if (engine != "direct" && engine != "next_reaction") {
+            std::cerr << "unknown engine: " << engine << '\n';
+            return 1;
+        }
+    }
+    for (auto const n : ring_species) {
+        if (!(n >= 1)) {
+            std::cerr << "ring_species must be at least 1: " << n << '\n';
+            return 1;
+        }
+    }
+    for (auto const r : reaction_counts) {
+        if (!(r >= 1)) {
+            std::cerr << "reactions must be at least 1: " << r << '\n';
+            return 1;
+        }
+        for (auto const density : densities) {
+            if (!(density > 0) || !(r / density >= 2)) {
+                std::cerr
+                    << "density " << density << " leaves fewer than two species for "
+                    << r << " reactions\n";
+                return 1;
+            }
+        }
+    }
+
+    bench::report report{"ssa", options.text("output", "")};
+
+    for (auto const& workload : workloads) {
+        if (workload == "ring") {
+            for (auto const n : ring_species) {
+                auto const species = std::size_t(n);
+                configuration const config{workload, species, species};
+
+                auto const ring = make_ring_model(species);
+                measure_engines(report, config, engines, ring, max_steps);
+            }
+        } else {
+            for (auto const r : reaction_counts) {
+                for (auto const density : densities) {
+                    auto const reactions = std::size_t(r);
+                    auto const species = std::size_t(r / density);
+                    configuration const config{workload, species, reactions};
+
+                    std::mt19937_64 random;
+                    auto const catalytic = make_catalytic_model(species, reactions, random);
+                    measure_engines(report, config, engines, catalytic, max_steps);
+                }
+            }
+        }
+    }
+}
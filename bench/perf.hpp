@@ -0,0 +1,202 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Hardware performance counters for the benchmark programs, read with the
+// Linux perf_event_open system call. Counters that cannot be opened, for
+// example in a container without access to the PMU or on other systems, are
+// skipped and reported as unavailable instead of failing the benchmark.
+
+#ifndef INCLUDED_SNSINFU_BENCH_PERF_HPP
+#define INCLUDED_SNSINFU_BENCH_PERF_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+
+namespace bench
+{
+    // Hardware event to count. `type` and `config` are the fields of
+    // perf_event_attr of the same names.
+    struct perf_event
+    {
+        std::string name;
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+
+    // Returns the events counted by default: cycles, instructions, branch
+    // misses, L1 data cache read misses, last-level cache read misses and
+    // data TLB read misses.
+    inline std::vector<perf_event>
+    default_perf_events()
+    {
+#ifdef __linux__
+        auto const cache_read_miss = [](std::uint64_t cache) {
+            return cache
+                | (std::uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8)
+                | (std::uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+        };
+
+        return {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {"l1d_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_L1D)},
+            {"llc_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_LL)},
+            {"dtlb_misses", PERF_TYPE_HW_CACHE, cache_read_miss(PERF_COUNT_HW_CACHE_DTLB)},
+        };
+#else
+        return {};
+#endif
+    }
+
+
+    // Set of counters of the calling thread, counting user-space events
+    // between `start()` and `stop()`. Each event is opened separately so
+    // that an unsupported event does not disable the others; the kernel may
+    // then multiplex them, and the values are scaled by the fraction of time
+    // each counter actually ran.
+    class perf_counters
+    {
+    public:
+        explicit perf_counters(std::vector<perf_event> const& events = default_perf_events())
+        {
+#ifdef __linux__
+            for (auto const& event : events) {
+                ::perf_event_attr attr;
+                std::memset(&attr, 0, sizeof attr);
+                attr.size = sizeof attr;
+                attr.type = event.type;
+                attr.config = event.config;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format =
+                    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                auto const fd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if (fd == -1) {
+                    _unavailable.push_back({event.name, std::strerror(errno)});
+                    continue;
+                }
+                _counters.push_back({event.name, fd});
+            }
+#else
+            for (auto const& event : events) {
+                _unavailable.push_back({event.name, "not supported on this system"});
+            }
+#endif
+        }
+
+        ~perf_counters()
+        {
+#ifdef __linux__
+            for (auto const& counter : _counters) {
+                ::close(counter.fd);
+            }
+#endif
+        }
+
+        perf_counters(perf_counters const&) = delete;
+        perf_counters& operator=(perf_counters const&) = delete;
+
+        // Returns true if any counter is available.
+        bool
+        available() const
+        {
+            return !_counters.empty();
+        }
+
+        // Returns the names of the events that could not be counted and the
+        // reasons.
+        std::vector<std::pair<std::string, std::string>> const&
+        unavailable() const
+        {
+            return _unavailable;
+        }
+
+        // Resets and starts the counters.
+        void
+        start()
+        {
+#ifdef __linux__
+            for (auto const& counter : _counters) {
+                ::ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // Stops the counters.
+        void
+        stop()
+        {
+#ifdef __linux__
+            for (auto const& counter : _counters) {
+                ::ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+#endif
+        }
+
+        // Returns the counts between the last `start()` and `stop()` as
+        // pairs of event name and count. Counters that were never scheduled
+        // on the PMU (e.g. because there are too few hardware counters) are
+        // omitted.
+        std::vector<std::pair<std::string, double>>
+        values() const
+        {
+            std::vector<std::pair<std::string, double>> result;
+#ifdef __linux__
+            for (auto const& counter : _counters) {
+                std::uint64_t data[3]; // value, time enabled, time running
+                if (::read(counter.fd, data, sizeof data) != ssize_t(sizeof data)) {
+                    continue;
+                }
+                if (data[2] == 0) {
+                    continue;
+                }
+                auto const scale = double(data[1]) / double(data[2]);
+                result.emplace_back(counter.name, double(data[0]) * scale);
+            }
+#endif
+            return result;
+        }
+
+    private:
+        struct counter
+        {
+            std::string name;
+            int fd;
+        };
+
+        std::vector<counter> _counters;
+        std::vector<std::pair<std::string, std::string>> _unavailable;
+    };
+
+
+    // Runs `fn()` with the counters enabled and returns the counts.
+    template<typename F>
+    std::vector<std::pair<std::string, double>>
+    count(perf_counters& counters, F fn)
+    {
+        counters.start();
+        fn();
+        counters.stop();
+        return counters.values();
+    }
+}
+
+#endif
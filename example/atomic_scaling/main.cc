@@ -0,0 +1,138 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <atomic_discrete_weights.hpp>
+#include <discrete_distribution.hpp>
+#include <sharded_discrete_weights.hpp>
+
+
+// discrete_weights guarded by a global mutex. This is the baseline that
+// atomic_discrete_weights replaces.
+class locked_discrete_weights
+{
+public:
+    explicit locked_discrete_weights(std::vector<double> const& weights)
+        : _weights{weights}
+    {
+    }
+
+    std::size_t
+    size() const
+    {
+        return _weights.size();
+    }
+
+    void
+    update(std::size_t i, double weight)
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _weights.update(i, weight);
+    }
+
+    template<typename RNG>
+    std::size_t
+    operator()(RNG& random)
+    {
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+        auto const u = uniform(random);
+
+        std::lock_guard<std::mutex> lock{_mutex};
+        return _weights.find(u * _weights.sum());
+    }
+
+private:
+    std::mutex _mutex;
+    cxx::discrete_weights _weights;
+};
+
+
+// Runs a prioritized-sampling workload: every thread repeatedly samples an
+// event from all events and updates the priority of a random event in its
+// own contiguous range. Returns the total number of sample-and-update
+// operations per second.
+template<typename Weights>
+double
+measure(Weights& weights, std::size_t num_threads, long ops_per_thread)
+{
+    using clock = std::chrono::steady_clock;
+    using seconds = std::chrono::duration<double>;
+
+    auto const num_events = weights.size();
+
+    std::vector<std::thread> threads;
+    auto const start = clock::now();
+
+    for (std::size_t t = 0; t < num_threads; t++) {
+        auto const begin = num_events * t / num_threads;
+        auto const end = num_events * (t + 1) / num_threads;
+
+        threads.emplace_back([&weights, t, begin, end, ops_per_thread] {
+            std::mt19937_64 random{t};
+            std::uniform_int_distribution<std::size_t> own_event{begin, end - 1};
+            std::uniform_real_distribution<double> priority{0.0, 1.0};
+            std::size_t checksum = 0;
+
+            for (long op = 0; op < ops_per_thread; op++) {
+                checksum += weights(random);
+                weights.update(own_event(random), priority(random));
+            }
+
+            if (checksum == 0) {
+                std::cerr << "unlikely\n";
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto const end = clock::now();
+
+    auto const ops = double(num_threads) * double(ops_per_thread);
+    return ops / seconds(end - start).count();
+}
+
+
+int
+main()
+{
+    // Compare a mutex-guarded discrete_weights, atomic_discrete_weights and
+    // sharded_discrete_weights with one shard per thread as the number of
+    // threads grows. Numbers beyond the number of hardware
+    // threads on the machine only show oversubscription.
+
+    std::size_t const num_events = 1000000;
+    long const ops_per_thread = 200000;
+
+    std::size_t const thread_sweep[] = {1, 2, 4, 8, 16, 32, 64};
+
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << '\n';
+    std::cout << "threads\tlocked(ops/s)\tatomic(ops/s)\tsharded(ops/s)\n";
+
+    std::vector<double> init(num_events, 1.0);
+    locked_discrete_weights locked{init};
+    cxx::atomic_discrete_weights atomic{init};
+
+    for (auto const num_threads : thread_sweep) {
+        auto const locked_rate = measure(locked, num_threads, ops_per_thread);
+        auto const atomic_rate = measure(atomic, num_threads, ops_per_thread);
+
+        cxx::sharded_discrete_weights sharded{init, num_threads};
+        auto const sharded_rate = measure(sharded, num_threads, ops_per_thread);
+
+        std::cout
+            << num_threads << '\t'
+            << locked_rate << '\t'
+            << atomic_rate << '\t'
+            << sharded_rate << '\n';
+    }
+}
@@ -8,6 +8,7 @@
 #include <random>
 #include <vector>
 
+#include <csr_graph.hpp>
 #include <discrete_distribution.hpp>
 
 
@@ -82,14 +83,23 @@ main()
 
 
     // Pre-compute which reactions are affected by a change of each species.
-    std::vector<std::vector<std::size_t>> dependencies(num_species);
+    // The graph is built in two passes (count, then insert) into two flat
+    // arrays instead of a vector per species.
+    cxx::csr_graph_builder builder{num_species};
+
+    for (auto const& rx : reactions) {
+        builder.count(rx.reactant);
+        builder.count(rx.catalyst);
+    }
 
     for (std::size_t rx_index = 0; rx_index < num_reactions; rx_index++) {
         auto const& rx = reactions[rx_index];
-        dependencies[rx.reactant].push_back(rx_index);
-        dependencies[rx.catalyst].push_back(rx_index);
+        builder.insert(rx.reactant, rx_index);
+        builder.insert(rx.catalyst, rx_index);
     }
 
+    cxx::csr_graph const dependencies = builder.finish();
+
 
     // Determine the rates.
     std::vector<double> initial_rates;
@@ -122,10 +132,10 @@ main()
 
         // Update affected rates (weights). This is the most expensive part in
         // a dense reaction network.
-        for (auto const dep : dependencies[rx.reactant]) {
+        for (auto const dep : dependencies.neighbors(rx.reactant)) {
             reaction_distr.update(dep, reactions[dep].rate(species));
         }
-        for (auto const dep : dependencies[rx.product]) {
+        for (auto const dep : dependencies.neighbors(rx.product)) {
             reaction_distr.update(dep, reactions[dep].rate(species));
         }
     }
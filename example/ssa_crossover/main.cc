@@ -0,0 +1,114 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <ssa.hpp>
+
+
+// Builds the random catalytic network of example/random_network:
+//
+//   R + C --> P + C  (R: reactant, C: catalyst, P: product)
+//
+cxx::ssa::reaction_network
+make_network(std::size_t num_species, std::size_t num_reactions, std::mt19937_64& random)
+{
+    cxx::ssa::reaction_network network{num_species};
+
+    while (network.reactions() < num_reactions) {
+        std::uniform_int_distribution<std::size_t> species{0, num_species - 1};
+        std::lognormal_distribution<double> base_rate;
+
+        auto const reactant = species(random);
+        auto const catalyst = species(random);
+        auto const product = species(random);
+        auto const rate = base_rate(random);
+
+        if (reactant == catalyst) {
+            continue;
+        }
+
+        network.add_reaction(
+            rate,
+            {{reactant, 1}, {catalyst, 1}},
+            {{product, 1}, {catalyst, 1}}
+        );
+    }
+
+    return network;
+}
+
+
+// Returns the number of steps per second achieved by an engine.
+template<typename Engine>
+double
+measure(Engine& engine, long steps)
+{
+    using clock = std::chrono::steady_clock;
+    using seconds = std::chrono::duration<double>;
+
+    auto const start = clock::now();
+    for (long step = 0; step < steps; step++) {
+        if (!engine.step()) {
+            break;
+        }
+    }
+    auto const end = clock::now();
+
+    return double(engine.steps()) / seconds(end - start).count();
+}
+
+
+int
+main()
+{
+    // Compare the direct method and the next reaction method on networks
+    // of fixed number of reactions with decreasing number of species. Fewer
+    // species means more reactions share a species, so more propensities
+    // change per step. Both methods pay O(log N) per changed propensity,
+    // but the next reaction method selects the next reaction in O(1) and
+    // consumes a single random number per step. Which engine wins at a
+    // given density depends on the machine; look for the row where the
+    // ratio of the last two columns crosses one.
+
+    std::size_t const num_reactions = 100000;
+    long const steps = 100000;
+
+    std::size_t const species_sweep[] = {
+        1000000, 100000, 10000, 3000, 1000
+    };
+
+    std::cout << "species\tdeps/step\tdirect(steps/s)\tnext_reaction(steps/s)\n";
+
+    for (auto const num_species : species_sweep) {
+        std::mt19937_64 random;
+
+        auto const network = make_network(num_species, num_reactions, random);
+
+        std::vector<cxx::ssa::count_type> counts;
+        while (counts.size() < num_species) {
+            std::poisson_distribution<cxx::ssa::count_type> count{10.0};
+            counts.push_back(1 + count(random));
+        }
+
+        // Each firing changes two species, each consumed by 2R/S reactions.
+        auto const deps = 4.0 * double(num_reactions) / double(num_species);
+
+        cxx::ssa::direct_engine<std::mt19937_64> direct{network, counts, random};
+        cxx::ssa::next_reaction_engine<std::mt19937_64> next{network, counts, random};
+
+        auto const direct_rate = measure(direct, steps);
+        auto const next_rate = measure(next, steps);
+
+        std::cout
+            << num_species << '\t'
+            << deps << '\t'
+            << direct_rate << '\t'
+            << next_rate << '\n';
+    }
+}
@@ -0,0 +1,364 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_ADAPTIVE_DISCRETE_DISTRIBUTION_HPP
+#define INCLUDED_SNSINFU_ADAPTIVE_DISCRETE_DISTRIBUTION_HPP
+
+// Discrete distribution that switches to an alias table while the weights do
+// not change, providing:
+//
+// - class cxx::adaptive_discrete_distribution<T>
+//   Discrete distribution sampling in O(1) during runs of samples without
+//   updates and in O(log N) otherwise.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    /*
+     * Discrete distribution over `[0, N)` that adapts to the ratio of
+     * updates to samples.
+     *
+     * The weights are kept in a sum tree, so `update` is O(log N). After
+     * `threshold()` consecutive samples without an update, an alias table
+     * is built in O(N) and later samples take O(1) time. The next `update`
+     * drops the table and sampling falls back to the sum tree. Thus a phase
+     * dominated by sampling pays for the table once, and a phase dominated
+     * by updates pays nothing for it.
+     *
+     * Samples follow the same distribution as `cxx::discrete_distribution`
+     * but are not the same values for the same random engine, as the alias
+     * table consumes random numbers differently.
+     *
+     * Unlike `cxx::discrete_distribution`, sampling modifies the object, so
+     * a single object must not be sampled from multiple threads.
+     */
+    template<typename T = int>
+    class adaptive_discrete_distribution
+    {
+    public:
+
+        /*
+         * Type of generated integer.
+         */
+        using result_type = T;
+
+
+        /*
+         * Returns the default threshold for N events: N samples, but at
+         * least 1024. Building the table costs about as much per event as
+         * one sample from the sum tree, and an alias sample saves little
+         * for small N, so the table pays off within about N samples.
+         */
+        static std::size_t
+        default_threshold(std::size_t events) noexcept
+        {
+            return events < 1024 ? 1024 : events;
+        }
+
+
+        /*
+         * Default constructor creates an empty distribution.
+         */
+        adaptive_discrete_distribution() = default;
+
+
+        /*
+         * Creates a distribution with given weights.
+         *
+         * Params:
+         *   weights   = Weight values. The weights must be non-negative
+         *               finite numbers.
+         *   threshold = Number of consecutive samples without an update
+         *               after which the alias table is built.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        explicit
+        adaptive_discrete_distribution(
+            std::vector<double> const& weights,
+            std::size_t threshold
+        )
+            : _weights{weights}
+            , _threshold{threshold}
+        {
+        }
+
+
+        /*
+         * Creates a distribution with given weights and the default
+         * threshold.
+         */
+        explicit
+        adaptive_discrete_distribution(std::vector<double> const& weights)
+            : adaptive_discrete_distribution{weights, default_threshold(weights.size())}
+        {
+        }
+
+
+        /*
+         * Creates a distribution with given weights and the default
+         * threshold.
+         */
+        adaptive_discrete_distribution(std::initializer_list<double> const& weights)
+            : adaptive_discrete_distribution{std::vector<double>{weights}}
+        {
+        }
+
+
+        /*
+         * Resets the distribution state. This function does nothing.
+         */
+        void
+        reset()
+        {
+        }
+
+
+        /*
+         * Returns the weights.
+         */
+        cxx::discrete_weights const&
+        weights() const noexcept
+        {
+            return _weights;
+        }
+
+
+        /*
+         * Returns the number of events.
+         */
+        std::size_t
+        size() const noexcept
+        {
+            return _weights.size();
+        }
+
+
+        /*
+         * Returns the minimum possible integer generated from this
+         * distribution, namely, zero.
+         */
+        result_type
+        min() const
+        {
+            return 0;
+        }
+
+
+        /*
+         * Returns the maximum possible integer generated from this
+         * distribution.
+         */
+        result_type
+        max() const
+        {
+            return result_type(_weights.size() - 1);
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         */
+        double
+        sum() const
+        {
+            return _weights.sum();
+        }
+
+
+        /*
+         * Returns the number of consecutive samples without an update after
+         * which the alias table is built.
+         */
+        std::size_t
+        threshold() const noexcept
+        {
+            return _threshold;
+        }
+
+
+        /*
+         * Returns true if samples are currently drawn from the alias table.
+         */
+        bool
+        has_alias_table() const noexcept
+        {
+            return _alias_ready;
+        }
+
+
+        /*
+         * Updates the weight of the number `i`. Drops the alias table.
+         *
+         * Time complexity:
+         *   O(log N).
+         */
+        void
+        update(result_type i, double weight)
+        {
+            _weights.update(std::size_t(i), weight);
+            _alias_ready = false;
+            _quiet_samples = 0;
+        }
+
+
+        /*
+         * Generates a random integer from the distribution.
+         *
+         * Time complexity:
+         *   O(1) with the alias table. O(log N) otherwise, plus O(N) when
+         *   the table is built.
+         */
+        template<typename RNG>
+        result_type
+        operator()(RNG& random)
+        {
+            if (!_alias_ready && ++_quiet_samples > _threshold && _weights.sum() > 0) {
+                build_alias_table();
+            }
+
+            if (_alias_ready) {
+                return result_type(sample_alias_table(random));
+            }
+
+            std::uniform_real_distribution<double> uniform{0.0, _weights.sum()};
+            return result_type(_weights.find(uniform(random)));
+        }
+
+
+    private:
+
+        /*
+         * Builds the alias table from the weights using Vose's method.
+         */
+        void
+        build_alias_table()
+        {
+            auto const n = _weights.size();
+            auto const scale = double(n) / _weights.sum();
+
+            _cutoffs.resize(n);
+            _aliases.resize(n);
+            _small.clear();
+            _large.clear();
+
+            // Any event with positive weight. Used to keep zero-weight
+            // events out of the table.
+            std::size_t positive = 0;
+
+            for (std::size_t i = 0; i < n; i++) {
+                _cutoffs[i] = _weights[i] * scale;
+                (_cutoffs[i] < 1 ? _small : _large).push_back(i);
+                if (_weights[i] > 0) {
+                    positive = i;
+                }
+            }
+
+            while (!_small.empty() && !_large.empty()) {
+                auto const s = _small.back();
+                auto const l = _large.back();
+                _small.pop_back();
+
+                _aliases[s] = l;
+                _cutoffs[l] -= 1 - _cutoffs[s];
+
+                if (_cutoffs[l] < 1) {
+                    _large.pop_back();
+                    _small.push_back(l);
+                }
+            }
+
+            // Leftovers have cutoffs close to one up to rounding errors. A
+            // zero-weight event must never be drawn, so it is redirected
+            // to a positive one in case rounding leaves it over.
+            for (auto const i : _large) {
+                _cutoffs[i] = 1;
+                _aliases[i] = i;
+            }
+            for (auto const i : _small) {
+                _cutoffs[i] = _weights[i] > 0 ? 1 : 0;
+                _aliases[i] = _weights[i] > 0 ? i : positive;
+            }
+
+            _alias_ready = true;
+        }
+
+
+        /*
+         * Draws an event from the alias table with a single uniform random
+         * number: its integral part selects a column and its fractional part
+         * decides between the column and its alias.
+         */
+        template<typename RNG>
+        std::size_t
+        sample_alias_table(RNG& random) const
+        {
+            auto const n = _cutoffs.size();
+            std::uniform_real_distribution<double> uniform{0.0, double(n)};
+
+            auto const u = uniform(random);
+            auto column = std::size_t(u);
+            if (column >= n) {
+                column = n - 1;
+            }
+
+            DISTR_ASSERT(_aliases[column] < n);
+            return u - double(column) < _cutoffs[column] ? column : _aliases[column];
+        }
+
+
+    private:
+        cxx::discrete_weights _weights;
+        std::size_t _threshold = 0;
+        std::size_t _quiet_samples = 0;
+        bool _alias_ready = false;
+        std::vector<double> _cutoffs;
+        std::vector<std::size_t> _aliases;
+        std::vector<std::size_t> _small;
+        std::vector<std::size_t> _large;
+    };
+}
+
+#undef DISTR_ASSERT
+
+#endif
@@ -0,0 +1,338 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_ATOMIC_DISCRETE_WEIGHTS_HPP
+#define INCLUDED_SNSINFU_ATOMIC_DISCRETE_WEIGHTS_HPP
+
+// Discrete weights updated by many threads at once, providing:
+//
+// - class cxx::atomic_discrete_weights
+//   Lock-free sum tree with fixed-point weights that any number of threads
+//   update and sample concurrently.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    /*
+     * Sum tree that supports concurrent updates from multiple threads
+     * without locks.
+     *
+     * Weights are stored as fixed-point integers: a weight w is held as
+     * round(w / resolution) units. An update exchanges the leaf and adds the
+     * difference to every ancestor with an atomic fetch_add. Integer addition
+     * is exact and associative, so once concurrent updates are finished
+     * every internal node equals the sum of its children exactly, regardless
+     * of how the updates interleaved.
+     *
+     * While updates are in flight an internal node may be transiently off by
+     * the deltas not yet propagated, so a concurrent sample may pick an
+     * event with a stale probability. It never returns an index out of range.
+     *
+     * The total weight must stay below 2^63 units. The default resolution,
+     * 2^-32, admits total weights up to about 2 * 10^9.
+     */
+    class atomic_discrete_weights
+    {
+        using unit_type = std::int64_t;
+
+    public:
+
+        /*
+         * Returns the default resolution, 2^-32.
+         */
+        static double
+        default_resolution() noexcept
+        {
+            return std::ldexp(1.0, -32);
+        }
+
+
+        /*
+         * Constructs a tree with given weights.
+         *
+         * Params:
+         *   weights    = Non-negative weights of the events.
+         *   resolution = Smallest representable weight. Weights are rounded
+         *                to multiples of this value.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        explicit
+        atomic_discrete_weights(
+            std::vector<double> const& weights,
+            double resolution = default_resolution()
+        )
+            : _events{weights.size()}
+            , _leaves{cxx::detail::sumtree_leaves(weights.size())}
+            , _resolution{resolution}
+        {
+            DISTR_ASSERT(resolution > 0);
+
+            auto const tree_size = 2 * _leaves - 1;
+            std::unique_ptr<unit_type[]> tree{new unit_type[tree_size]()};
+
+            for (std::size_t i = 0; i < weights.size(); i++) {
+                tree[_leaves - 1 + i] = to_units(weights[i]);
+            }
+
+            for (std::size_t node = _leaves - 1; node-- > 0; ) {
+                tree[node] = tree[2 * node + 1] + tree[2 * node + 2];
+            }
+
+            _nodes.reset(new std::atomic<unit_type>[tree_size]);
+            for (std::size_t node = 0; node < tree_size; node++) {
+                _nodes[node].store(tree[node], std::memory_order_relaxed);
+            }
+        }
+
+
+        atomic_discrete_weights(atomic_discrete_weights const&) = delete;
+        atomic_discrete_weights& operator=(atomic_discrete_weights const&) = delete;
+
+
+        /*
+         * Returns the number of events.
+         */
+        inline std::size_t
+        size() const noexcept
+        {
+            return _events;
+        }
+
+
+        /*
+         * Returns the resolution of weights.
+         */
+        inline double
+        resolution() const noexcept
+        {
+            return _resolution;
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         *
+         * Time complexity:
+         *   O(1).
+         */
+        double
+        sum() const noexcept
+        {
+            return to_weight(load(0));
+        }
+
+
+        /*
+         * Returns the weight of the i-th event, rounded to the resolution.
+         */
+        double
+        operator[](std::size_t i) const noexcept
+        {
+            DISTR_ASSERT(i < _events);
+            return to_weight(load(_leaves - 1 + i));
+        }
+
+
+        /*
+         * Returns a copy of the weights as a `cxx::discrete_weights`. The
+         * copy is consistent only if no update runs concurrently.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        cxx::discrete_weights
+        snapshot() const
+        {
+            std::vector<double> weights(_events);
+            for (std::size_t i = 0; i < _events; i++) {
+                weights[i] = (*this)[i];
+            }
+            return cxx::discrete_weights{weights};
+        }
+
+
+        /*
+         * Updates the weight of the i-th event. Thread-safe.
+         *
+         * Params:
+         *   i      = Index of the event to update.
+         *   weight = New weight. Must be non-negative.
+         *
+         * Time complexity:
+         *   O(log N) atomic operations.
+         */
+        void
+        update(std::size_t i, double weight) noexcept
+        {
+            DISTR_ASSERT(i < _events);
+
+            auto node = _leaves - 1 + i;
+            auto const units = to_units(weight);
+            auto const old_units = _nodes[node].exchange(units, std::memory_order_relaxed);
+            auto const delta = units - old_units;
+
+            if (delta == 0) {
+                return;
+            }
+
+            while (node > 0) {
+                node = (node - 1) / 2;
+                _nodes[node].fetch_add(delta, std::memory_order_relaxed);
+            }
+        }
+
+
+        /*
+         * Finds the event whose cumulative weight interval covers given probe
+         * value. Thread-safe. See `discrete_weights::find`.
+         *
+         * Time complexity:
+         *   O(log N).
+         */
+        std::size_t
+        find(double probe) const noexcept
+        {
+            auto const max_units = std::numeric_limits<unit_type>::max();
+            auto const units = probe / _resolution;
+
+            if (units >= double(max_units)) {
+                return find_units(max_units);
+            }
+            return find_units(unit_type(units));
+        }
+
+
+        /*
+         * Samples an event with probability proportional to its weight.
+         * Thread-safe.
+         *
+         * Time complexity:
+         *   O(log N).
+         */
+        template<typename RNG>
+        std::size_t
+        operator()(RNG& random) const
+        {
+            std::uniform_real_distribution<double> uniform{0.0, 1.0};
+            auto const total = load(0);
+            return find_units(unit_type(uniform(random) * double(total)));
+        }
+
+
+    private:
+
+        // Loads a node. A node may be transiently negative while deltas are
+        // in flight; it is clamped to zero.
+        unit_type
+        load(std::size_t node) const noexcept
+        {
+            auto const value = _nodes[node].load(std::memory_order_relaxed);
+            return value < 0 ? 0 : value;
+        }
+
+
+        std::size_t
+        find_units(unit_type probe) const noexcept
+        {
+            auto const tree_size = 2 * _leaves - 1;
+            std::size_t node = 0;
+
+            for (;;) {
+                auto const lchild = 2 * node + 1;
+                auto const rchild = 2 * node + 2;
+
+                if (lchild >= tree_size) {
+                    break;
+                }
+
+                auto const lsum = load(lchild);
+                if (probe < lsum) {
+                    node = lchild;
+                } else {
+                    probe -= lsum;
+                    node = rchild;
+                }
+            }
+
+            auto index = node - (_leaves - 1);
+
+            if (index >= _events) {
+                index = _events == 0 ? 0 : _events - 1;
+            }
+
+            return index;
+        }
+
+
+        unit_type
+        to_units(double weight) const noexcept
+        {
+            DISTR_ASSERT(weight >= 0);
+            DISTR_ASSERT(weight / _resolution < double(std::numeric_limits<unit_type>::max()));
+            return unit_type(std::llround(weight / _resolution));
+        }
+
+
+        double
+        to_weight(unit_type units) const noexcept
+        {
+            return double(units) * _resolution;
+        }
+
+
+    private:
+        std::size_t _events;
+        std::size_t _leaves;
+        double _resolution;
+        std::unique_ptr<std::atomic<unit_type>[]> _nodes;
+    };
+}
+
+#undef DISTR_ASSERT
+
+#endif
@@ -0,0 +1,473 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_CONCURRENT_DISCRETE_DISTRIBUTION_HPP
+#define INCLUDED_SNSINFU_CONCURRENT_DISCRETE_DISTRIBUTION_HPP
+
+// Discrete distribution sampled by many threads while one thread updates it,
+// providing:
+//
+// - class cxx::concurrent_discrete_distribution<T>
+//   Discrete distribution with a single writer thread and any number of
+//   reader threads.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    namespace detail
+    {
+        /*
+         * Sum tree of atomic nodes protected by a sequence lock. A single
+         * writer increments the sequence number to an odd value, modifies
+         * the tree and increments the number again to an even value. A
+         * reader reads the tree between two loads of the sequence number and
+         * retries if the numbers differ or are odd. Readers never block the
+         * writer and never observe a partially updated tree.
+         *
+         * Nodes are accessed with relaxed atomic operations, so concurrent
+         * reads and writes are well-defined; ordering is provided by fences
+         * around the sequence number.
+         */
+        struct seqlock_sumtree
+        {
+            std::atomic<std::uint64_t>* sequence = nullptr;
+            std::atomic<double>* nodes = nullptr;
+            std::size_t leaves = 0;
+            std::size_t events = 0;
+
+
+            /*
+             * Starts a write section. Must be called by the single writer.
+             */
+            void
+            begin_write() const noexcept
+            {
+                auto const seq = sequence->load(std::memory_order_relaxed);
+                DISTR_ASSERT(seq % 2 == 0);
+                sequence->store(seq + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+
+
+            /*
+             * Ends a write section.
+             */
+            void
+            end_write() const noexcept
+            {
+                auto const seq = sequence->load(std::memory_order_relaxed);
+                sequence->store(seq + 1, std::memory_order_release);
+            }
+
+
+            /*
+             * Updates a leaf and its ancestors. Must be called in a write
+             * section.
+             */
+            void
+            update(std::size_t i, double weight) const noexcept
+            {
+                DISTR_ASSERT(i < events);
+                DISTR_ASSERT(weight >= 0);
+
+                auto node = leaves + i - 1;
+                nodes[node].store(weight, std::memory_order_relaxed);
+
+                while (node > 0) {
+                    node = (node - 1) / 2;
+                    auto const lchild = nodes[2 * node + 1].load(std::memory_order_relaxed);
+                    auto const rchild = nodes[2 * node + 2].load(std::memory_order_relaxed);
+                    nodes[node].store(lchild + rchild, std::memory_order_relaxed);
+                }
+            }
+
+
+            /*
+             * Runs `read_fn()` until it completes without a concurrent
+             * write, and returns its result. `read_fn` must only load nodes
+             * and must tolerate inconsistent values, whose results are
+             * discarded. After repeated retries the reader yields, so that a
+             * writer preempted in a write section can proceed when threads
+             * outnumber cores.
+             */
+            template<typename Read>
+            auto
+            read(Read read_fn) const -> decltype(read_fn())
+            {
+                return read(read_fn, [](std::uint64_t) {});
+            }
+
+
+            /*
+             * Same as above, but calls `stalled(seq)` whenever the reader
+             * yields while a write section with sequence number `seq` is in
+             * progress. `stalled` may throw to give up waiting for a writer
+             * that will never end the section.
+             */
+            template<typename Read, typename Stalled>
+            auto
+            read(Read read_fn, Stalled stalled) const -> decltype(read_fn())
+            {
+                for (unsigned retry = 1; ; retry++) {
+                    auto const yield = retry % 64 == 0;
+                    if (yield) {
+                        std::this_thread::yield();
+                    }
+
+                    auto const before = sequence->load(std::memory_order_acquire);
+                    if (before % 2 != 0) {
+                        if (yield) {
+                            stalled(before);
+                        }
+                        continue;
+                    }
+
+                    auto result = read_fn();
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    auto const after = sequence->load(std::memory_order_relaxed);
+                    if (before == after) {
+                        return result;
+                    }
+                }
+            }
+
+
+            inline double
+            load(std::size_t node) const noexcept
+            {
+                return nodes[node].load(std::memory_order_relaxed);
+            }
+
+
+            /*
+             * Descends the tree. Same as `discrete_weights::find`, but the
+             * result is meaningful only if the tree is not modified during
+             * the search.
+             */
+            std::size_t
+            find(double probe) const noexcept
+            {
+                auto const tree_size = 2 * leaves - 1;
+                std::size_t node = 0;
+
+                for (;;) {
+                    auto const lchild = 2 * node + 1;
+                    auto const rchild = 2 * node + 2;
+
+                    if (lchild >= tree_size) {
+                        break;
+                    }
+
+                    auto const lsum = load(lchild);
+                    if (probe < lsum) {
+                        node = lchild;
+                    } else {
+                        probe -= lsum;
+                        node = rchild;
+                    }
+                }
+
+                auto index = node - (leaves - 1);
+
+                if (index >= events) {
+                    index = events - 1;
+                }
+
+                return index;
+            }
+        };
+    }
+
+
+    /*
+     * Discrete distribution that can be sampled concurrently with updates.
+     *
+     * One thread (the writer) calls `update`. Any number of threads (the
+     * readers) call `operator()`, `find`, `sum`, `operator[]` and `snapshot`
+     * at the same time. Readers never block the writer, and every query sees
+     * the weights as of a single version: a reader never observes parent and
+     * child sums from different updates. A reader retries its query only if
+     * an update overlapped with it.
+     *
+     * `cxx::discrete_distribution` is unaffected and remains the fastest
+     * choice when a single thread both samples and updates.
+     *
+     * The object is neither copyable nor movable. Share it by reference.
+     */
+    template<typename T = int>
+    class concurrent_discrete_distribution
+    {
+    public:
+
+        /*
+         * Type of generated integer.
+         */
+        using result_type = T;
+
+
+        /*
+         * Constructs a distribution with given weights.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        explicit
+        concurrent_discrete_distribution(std::vector<double> const& weights)
+            : concurrent_discrete_distribution{cxx::discrete_weights{weights}}
+        {
+        }
+
+
+        /*
+         * Constructs a distribution with weights copied from given tree.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        template<typename Storage>
+        explicit
+        concurrent_discrete_distribution(cxx::basic_discrete_weights<Storage> const& weights)
+        {
+            auto const leaves = weights.leaves() == 0 ? 1 : weights.leaves();
+            auto const tree_size = 2 * leaves - 1;
+
+            _nodes.reset(new std::atomic<double>[tree_size]);
+            for (std::size_t node = 0; node < tree_size; node++) {
+                auto const value = weights.leaves() == 0 ? 0.0 : weights.storage().data()[node];
+                _nodes[node].store(value, std::memory_order_relaxed);
+            }
+
+            _tree.sequence = &_sequence;
+            _tree.nodes = _nodes.get();
+            _tree.leaves = leaves;
+            _tree.events = weights.size();
+        }
+
+
+        concurrent_discrete_distribution(concurrent_discrete_distribution const&) = delete;
+        concurrent_discrete_distribution& operator=(concurrent_discrete_distribution const&) = delete;
+
+
+        /*
+         * Returns the number of events.
+         */
+        inline std::size_t
+        size() const noexcept
+        {
+            return _tree.events;
+        }
+
+
+        /*
+         * Returns the smallest possible value.
+         */
+        inline result_type
+        min() const noexcept
+        {
+            return 0;
+        }
+
+
+        /*
+         * Returns the largest possible value.
+         */
+        inline result_type
+        max() const noexcept
+        {
+            return result_type(size() - 1);
+        }
+
+
+        /*
+         * Returns the version of the weights. It is incremented by two on
+         * every update.
+         */
+        std::uint64_t
+        version() const noexcept
+        {
+            return _tree.read([&] {
+                return _sequence.load(std::memory_order_relaxed);
+            });
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         *
+         * Time complexity:
+         *   O(1) in absence of concurrent updates.
+         */
+        double
+        sum() const noexcept
+        {
+            return _tree.read([&] {
+                return _tree.load(0);
+            });
+        }
+
+
+        /*
+         * Returns the weight of the i-th event.
+         */
+        double
+        operator[](std::size_t i) const noexcept
+        {
+            DISTR_ASSERT(i < size());
+            return _tree.read([&] {
+                return _tree.load(_tree.leaves + i - 1);
+            });
+        }
+
+
+        /*
+         * Returns a consistent copy of the weights.
+         *
+         * Time complexity:
+         *   O(N) in absence of concurrent updates.
+         */
+        cxx::discrete_weights
+        snapshot() const
+        {
+            auto const tree_size = 2 * _tree.leaves - 1;
+            cxx::vector_storage<> storage{tree_size};
+
+            _tree.read([&] {
+                for (std::size_t node = 0; node < tree_size; node++) {
+                    storage.data()[node] = _tree.load(node);
+                }
+                return 0;
+            });
+
+            return cxx::discrete_weights{std::move(storage), _tree.events, _tree.leaves};
+        }
+
+
+        /*
+         * Finds the event whose cumulative weight interval covers given probe
+         * value. See `discrete_weights::find`.
+         *
+         * Time complexity:
+         *   O(log N) in absence of concurrent updates.
+         */
+        std::size_t
+        find(double probe) const noexcept
+        {
+            return _tree.read([&] {
+                return _tree.find(probe);
+            });
+        }
+
+
+        /*
+         * Generates a random integer with probability proportional to its
+         * weight. Thread-safe. Consumes the same random numbers and gives the
+         * same result as `cxx::discrete_distribution` with the same weights.
+         *
+         * Time complexity:
+         *   O(log N) in absence of concurrent updates.
+         */
+        template<typename RNG>
+        result_type
+        operator()(RNG& random) const
+        {
+            std::uniform_real_distribution<double> uniform{0.0, 1.0};
+            auto const u = uniform(random);
+
+            return result_type(_tree.read([&] {
+                return _tree.find(u * _tree.load(0));
+            }));
+        }
+
+
+        /*
+         * Updates the weight of the i-th event. Only one thread may update
+         * the distribution at a time.
+         *
+         * Time complexity:
+         *   O(log N).
+         */
+        void
+        update(std::size_t i, double weight) noexcept
+        {
+            _tree.begin_write();
+            _tree.update(i, weight);
+            _tree.end_write();
+        }
+
+
+        /*
+         * Updates weights of multiple events as a single version. Readers
+         * observe either none or all of the updates.
+         *
+         * Params:
+         *   indices = Indices of events to update.
+         *   weights = New weights. Must have the same size as `indices`.
+         *
+         * Time complexity:
+         *   O(K log N) where K is the number of updated events.
+         */
+        void
+        update(std::vector<std::size_t> const& indices, std::vector<double> const& weights) noexcept
+        {
+            DISTR_ASSERT(indices.size() == weights.size());
+            _tree.begin_write();
+            for (std::size_t k = 0; k < indices.size(); k++) {
+                _tree.update(indices[k], weights[k]);
+            }
+            _tree.end_write();
+        }
+
+
+    private:
+        std::atomic<std::uint64_t> _sequence {0};
+        std::unique_ptr<std::atomic<double>[]> _nodes;
+        detail::seqlock_sumtree _tree;
+    };
+}
+
+#undef DISTR_ASSERT
+
+#endif
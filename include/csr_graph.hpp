@@ -0,0 +1,380 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_CSR_GRAPH_HPP
+#define INCLUDED_SNSINFU_CSR_GRAPH_HPP
+
+// Compact adjacency lists for dependency graphs, providing:
+//
+// - class cxx::csr_graph
+//   Immutable directed graph in compressed sparse row form.
+//
+// - class cxx::csr_graph_builder
+//   Builds a csr_graph in two passes over the edges.
+//
+// - function cxx::reverse_cuthill_mckee
+//   Computes a bandwidth-reducing node ordering of a graph.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    class csr_graph_builder;
+
+
+    // GRAPH -----------------------------------------------------------------
+
+    /*
+     * Directed graph stored in compressed sparse row form. The targets of
+     * all edges are stored in a single array grouped by source node, and an
+     * offset array points to the start of each group. A graph of N nodes and
+     * E edges takes exactly N + 1 + E words in two allocations.
+     */
+    class csr_graph
+    {
+    public:
+
+        /*
+         * Contiguous range of node indices.
+         */
+        struct range
+        {
+            std::size_t const* first;
+            std::size_t const* last;
+
+            inline std::size_t const*
+            begin() const noexcept
+            {
+                return first;
+            }
+
+            inline std::size_t const*
+            end() const noexcept
+            {
+                return last;
+            }
+
+            inline std::size_t
+            size() const noexcept
+            {
+                return std::size_t(last - first);
+            }
+        };
+
+
+        /*
+         * Default constructor creates an empty graph.
+         */
+        csr_graph() = default;
+
+
+        /*
+         * Returns the number of nodes.
+         */
+        inline std::size_t
+        nodes() const noexcept
+        {
+            return _offsets.empty() ? 0 : _offsets.size() - 1;
+        }
+
+
+        /*
+         * Returns the number of edges.
+         */
+        inline std::size_t
+        edges() const noexcept
+        {
+            return _targets.size();
+        }
+
+
+        /*
+         * Returns the targets of the edges going out of a node.
+         *
+         * Time complexity:
+         *   O(1).
+         */
+        inline range
+        neighbors(std::size_t node) const
+        {
+            DISTR_ASSERT(node < nodes());
+            return range{
+                _targets.data() + _offsets[node],
+                _targets.data() + _offsets[node + 1]
+            };
+        }
+
+
+        /*
+         * Returns the offset array of size `nodes() + 1`.
+         */
+        inline std::size_t const*
+        offsets() const noexcept
+        {
+            return _offsets.data();
+        }
+
+
+        /*
+         * Returns the target array of size `edges()`.
+         */
+        inline std::size_t const*
+        targets() const noexcept
+        {
+            return _targets.data();
+        }
+
+
+    private:
+        friend class csr_graph_builder;
+
+        std::vector<std::size_t> _offsets;
+        std::vector<std::size_t> _targets;
+    };
+
+
+    // BUILDER ---------------------------------------------------------------
+
+    /*
+     * Builds a `csr_graph` without intermediate per-node containers. The
+     * caller enumerates the edges twice: first calling `count` for each
+     * edge to size the groups, then calling `insert` for each edge in the
+     * same or any other order to fill them. Targets of a node appear in the
+     * order they are inserted.
+     *
+     * Example:
+     *
+     *   cxx::csr_graph_builder builder{n};
+     *   for (auto const& e : edges) builder.count(e.source);
+     *   for (auto const& e : edges) builder.insert(e.source, e.target);
+     *   cxx::csr_graph graph = builder.finish();
+     */
+    class csr_graph_builder
+    {
+    public:
+
+        /*
+         * Starts building a graph of given number of nodes.
+         */
+        explicit
+        csr_graph_builder(std::size_t nodes)
+        {
+            _graph._offsets.assign(nodes + 1, 0);
+        }
+
+
+        /*
+         * Counts edges going out of a node. Must be called before any call
+         * to `insert`.
+         *
+         * Params:
+         *   source = Source node of the edges.
+         *   count  = Number of edges.
+         */
+        inline void
+        count(std::size_t source, std::size_t count = 1)
+        {
+            DISTR_ASSERT(!_filling);
+            DISTR_ASSERT(source < _graph.nodes());
+            _graph._offsets[source + 1] += count;
+        }
+
+
+        /*
+         * Inserts an edge. The edge must have been counted.
+         *
+         * Params:
+         *   source = Source node of the edge.
+         *   target = Target node of the edge.
+         */
+        inline void
+        insert(std::size_t source, std::size_t target)
+        {
+            if (!_filling) {
+                start_filling();
+            }
+            DISTR_ASSERT(source < _graph.nodes());
+            DISTR_ASSERT(_cursor[source] < _graph._offsets[source + 1]);
+            _graph._targets[_cursor[source]++] = target;
+        }
+
+
+        /*
+         * Returns the built graph. The builder is left empty.
+         */
+        csr_graph
+        finish()
+        {
+            if (!_filling) {
+                start_filling();
+            }
+#ifdef DISTR_DEBUG
+            for (std::size_t node = 0; node < _graph.nodes(); node++) {
+                DISTR_ASSERT(_cursor[node] == _graph._offsets[node + 1]);
+            }
+#endif
+            _cursor.clear();
+            _cursor.shrink_to_fit();
+            _filling = false;
+
+            return std::move(_graph);
+        }
+
+
+    private:
+
+        void
+        start_filling()
+        {
+            auto& offsets = _graph._offsets;
+
+            for (std::size_t node = 0; node + 1 < offsets.size(); node++) {
+                offsets[node + 1] += offsets[node];
+            }
+
+            _graph._targets.resize(offsets.back());
+            _cursor.assign(offsets.begin(), offsets.end() - 1);
+            _filling = true;
+        }
+
+
+    private:
+        csr_graph _graph;
+        std::vector<std::size_t> _cursor;
+        bool _filling = false;
+    };
+
+
+    // ORDERING --------------------------------------------------------------
+
+    /*
+     * Computes the reverse Cuthill-McKee ordering of an undirected graph.
+     * Nodes connected by edges get nearby positions in the ordering, so
+     * arrays indexed by the new positions have better locality when
+     * neighboring nodes are accessed together.
+     *
+     * Params:
+     *   graph = Graph whose edges are symmetric, i.e., if j is a neighbor of
+     *           i then i is a neighbor of j.
+     *
+     * Returns:
+     *   Vector `order` such that `order[k]` is the node placed at position
+     *   k. It is a permutation of `0, ..., graph.nodes()-1`.
+     *
+     * Time complexity:
+     *   O(N + E log D) where N is the number of nodes, E the number of edges
+     *   and D the maximum degree.
+     */
+    inline std::vector<std::size_t>
+    reverse_cuthill_mckee(cxx::csr_graph const& graph)
+    {
+        auto const nodes = graph.nodes();
+
+        std::vector<std::size_t> degree(nodes);
+        for (std::size_t node = 0; node < nodes; node++) {
+            degree[node] = graph.neighbors(node).size();
+        }
+
+        // Start each connected component from a node of minimum degree,
+        // which tends to lie on the periphery.
+        std::vector<std::size_t> seeds(nodes);
+        for (std::size_t node = 0; node < nodes; node++) {
+            seeds[node] = node;
+        }
+        std::stable_sort(seeds.begin(), seeds.end(), [&](std::size_t i, std::size_t j) {
+            return degree[i] < degree[j];
+        });
+
+        std::vector<std::size_t> order;
+        order.reserve(nodes);
+        std::vector<bool> visited(nodes, false);
+
+        for (auto const seed : seeds) {
+            if (visited[seed]) {
+                continue;
+            }
+            visited[seed] = true;
+            order.push_back(seed);
+
+            // Breadth-first search using `order` itself as the queue.
+            // Unvisited neighbors are enqueued in ascending degree.
+            for (auto head = order.size() - 1; head < order.size(); head++) {
+                auto const first_new = order.size();
+
+                for (auto const next : graph.neighbors(order[head])) {
+                    if (!visited[next]) {
+                        visited[next] = true;
+                        order.push_back(next);
+                    }
+                }
+
+                std::stable_sort(
+                    order.begin() + std::ptrdiff_t(first_new),
+                    order.end(),
+                    [&](std::size_t i, std::size_t j) {
+                        return degree[i] < degree[j];
+                    }
+                );
+            }
+        }
+
+        std::reverse(order.begin(), order.end());
+
+        return order;
+    }
+
+
+    /*
+     * Returns the inverse of a permutation: if `order[k] = i` then
+     * `inverse[i] = k`.
+     */
+    inline std::vector<std::size_t>
+    invert_permutation(std::vector<std::size_t> const& order)
+    {
+        std::vector<std::size_t> inverse(order.size());
+        for (std::size_t k = 0; k < order.size(); k++) {
+            inverse[order[k]] = k;
+        }
+        return inverse;
+    }
+}
+
+#undef DISTR_ASSERT
+
+#endif
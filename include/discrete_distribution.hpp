@@ -29,21 +29,59 @@
 // This is a single header-only library for C++11 and later, providing:
 //
 // - class cxx::discrete_weights
-//   Holds probability weights of a disctete distribution.
+//   Holds probability weights of a disctete distribution. Weights can be
+//   saved and loaded in a binary format with `write_binary`/`read_binary`.
+//
+// - class cxx::basic_discrete_weights
+//   discrete_weights with customizable storage of the sum tree.
+//
+// - class cxx::discrete_weights_view
+//   discrete_weights operating on a caller-provided array.
 //
 // - class cxx::discrete_distribution
 //   A random number distribution of integers with given weights. This class
 //   allows efficient modification of the weights.
 //
+// Both classes can allocate memory with a custom allocator. With C++17,
+// cxx::pmr::discrete_weights and cxx::pmr::discrete_distribution use
+// std::pmr::polymorphic_allocator. discrete_distribution can also sample
+// from a user-provided weights class (backend) instead of the sum tree.
+//
+// Define DISTR_STATS to make discrete_weights collect operation counts and
+// latencies (see `discrete_weights_stats`). The macro changes the layout of
+// the classes, so define it consistently in all translation units. Latency
+// is timed on every DISTR_STATS_LATENCY_PERIOD-th call (default 16, must be
+// a power of two).
+//
+// Searches in trees of up to DISTR_BRANCHLESS_LEAVES leaves (default 65536)
+// use branchless descent, which is faster while the tree fits in cache.
+// Define the macro consistently in all translation units to tune it.
+//
 // See: https://github.com/snsinfu/cxx-distr/
 
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <initializer_list>
+#include <ios>
 #include <istream>
+#include <limits>
+#include <memory>
+#include <new>
 #include <ostream>
 #include <random>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 
@@ -53,105 +91,1513 @@
 #  define DISTR_ASSERT(pred)
 #endif
 
+#ifdef DISTR_STATS
+#  include <atomic>
+#  include <chrono>
+#  define DISTR_STATS_ONLY(stmt) stmt
+#else
+#  define DISTR_STATS_ONLY(stmt)
+#endif
+
+// Use std::from_chars and std::to_chars for text I/O if available (C++17).
+#if defined(__has_include)
+#  if __has_include(<charconv>) && __cplusplus >= 201703L
+#    include <charconv>
+#  endif
+#endif
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#  define DISTR_HAS_TO_CHARS
+#endif
+
+// Provide std::pmr aliases if available (C++17).
+#if defined(__has_include)
+#  if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#    include <memory_resource>
+#  endif
+#endif
+
+#if defined(__cpp_lib_memory_resource) && __cpp_lib_memory_resource >= 201603L
+#  define DISTR_HAS_MEMORY_RESOURCE
+#endif
+
 
 namespace cxx
 {
-    // WEIGHTS ---------------------------------------------------------------
+    namespace detail
+    {
+        /*
+         * Largest number of leaves of a sum tree searched without branches.
+         * See `basic_discrete_weights::find`.
+         */
+#ifdef DISTR_BRANCHLESS_LEAVES
+        constexpr std::size_t branchless_leaves = DISTR_BRANCHLESS_LEAVES;
+#else
+        constexpr std::size_t branchless_leaves = std::size_t(1) << 16;
+#endif
+
+
+        /*
+         * Returns the number of leaves of the sum tree for given number of
+         * events: the smallest power of two not less than `events`.
+         *
+         * Throws:
+         *   std::length_error if the tree would have more nodes than
+         *   std::size_t can count.
+         */
+        inline std::size_t
+        sumtree_leaves(std::size_t events)
+        {
+            // 2 * leaves - 1 nodes must fit in size_t.
+            std::size_t const max_leaves = std::numeric_limits<std::size_t>::max() / 2 + 1;
+
+            if (events > max_leaves) {
+                throw std::length_error{"too many events for a sum tree"};
+            }
+
+            std::size_t leaves = 1;
+
+            for (;;) {
+                if (leaves >= events) {
+                    break;
+                }
+                leaves *= 2;
+            }
+
+            return leaves;
+        }
+
+
+        /*
+         * Fills the internal nodes of a sum tree from its leaves. The tree
+         * has `2 * leaves - 1` nodes stored as an array using the usual
+         * scheme:
+         *
+         *   root = 0 ,
+         *   parent(node) = (node - 1) / 2 .
+         *
+         * Time complexity:
+         *   O(N) where N is the number of leaves.
+         */
+        inline void
+        build_sumtree(double* tree, std::size_t leaves) noexcept
+        {
+            // Fill internal nodes from leaves to the root. Recall that each
+            // node contains the sum of the weights of its children.
+            for (std::size_t layer = 1; ; layer++) {
+                auto const layer_size = leaves >> layer;
+                if (layer_size == 0) {
+                    break;
+                }
+
+                auto const start = layer_size - 1;
+                auto const end = start + layer_size;
+
+                DISTR_ASSERT(end < leaves);
+                DISTR_ASSERT(start < end);
+
+                for (std::size_t node = start; node < end; node++) {
+                    auto const lchild = 2 * node + 1;
+                    auto const rchild = 2 * node + 2;
+                    tree[node] = tree[lchild] + tree[rchild];
+                }
+            }
+        }
+
+
+        /*
+         * Locale-independent text I/O of numbers. Numbers are read token by
+         * token directly from the stream buffer and converted with
+         * std::from_chars (C++17) or std::strtod, bypassing the per-value
+         * sentry and num_get facet of formatted stream input. Numbers are
+         * written in the shortest form that reads back to the same value,
+         * with std::to_chars (C++17) or the Grisu2 algorithm below.
+         */
+        namespace text_format
+        {
+            // Enough for any double in the shortest form, e.g.
+            // "-2.2250738585072014e-308".
+            constexpr std::size_t format_capacity = 32;
+
+
+            inline bool
+            is_space(int ch) noexcept
+            {
+                return ch == ' ' || (ch >= '\t' && ch <= '\r');
+            }
+
+
+            /*
+             * Reads a whitespace-delimited token into `token` as a
+             * null-terminated string. Leading whitespace is skipped and the
+             * delimiter following the token is not consumed. Tokens of any
+             * length are accepted. `token` is used as a buffer that only
+             * grows, so reusing it across calls avoids allocations.
+             *
+             * Returns:
+             *   The length of the token, or zero on failure. `state` is set
+             *   to failbit and/or eofbit accordingly.
+             */
+            template<typename Char, typename Tr>
+            std::size_t
+            read_token(
+                std::basic_streambuf<Char, Tr>& buf,
+                std::string& token,
+                std::ios_base::iostate& state
+            )
+            {
+                if (token.size() < 64) {
+                    token.resize(64);
+                }
+
+                auto ch = buf.sgetc();
+
+                while (!Tr::eq_int_type(ch, Tr::eof()) &&
+                       is_space(int(Tr::to_int_type(Tr::to_char_type(ch))))) {
+                    ch = buf.snextc();
+                }
+
+                std::size_t length = 0;
+
+                for (;;) {
+                    if (Tr::eq_int_type(ch, Tr::eof())) {
+                        state |= std::ios_base::eofbit;
+                        break;
+                    }
+
+                    auto const code = Tr::to_int_type(Tr::to_char_type(ch));
+                    if (is_space(int(code))) {
+                        break;
+                    }
+                    if (code < 0 || code > 127) {
+                        state |= std::ios_base::failbit;
+                        return 0;
+                    }
+
+                    // Keep room for the terminator.
+                    if (length + 1 == token.size()) {
+                        token.resize(2 * token.size());
+                    }
+                    token[length++] = char(code);
+                    ch = buf.snextc();
+                }
+
+                token[length] = '\0';
+
+                if (length == 0) {
+                    state |= std::ios_base::failbit;
+                }
+
+                return length;
+            }
+
+
+            inline bool
+            parse(char* token, std::size_t length, double& value) noexcept
+            {
+#ifdef DISTR_HAS_TO_CHARS
+                // from_chars does not accept a leading '+'.
+                if (length > 1 && token[0] == '+' && token[1] != '-') {
+                    token++;
+                    length--;
+                }
+                auto const result = std::from_chars(token, token + length, value);
+                return result.ec == std::errc{} && result.ptr == token + length;
+#else
+                // strtod expects the decimal point of the C locale. Swap it
+                // with '.' so that the text reads the same in any locale.
+                auto const point = *std::localeconv()->decimal_point;
+                if (point != '.') {
+                    for (std::size_t i = 0; i < length; i++) {
+                        if (token[i] == point) {
+                            return false;
+                        }
+                        if (token[i] == '.') {
+                            token[i] = point;
+                        }
+                    }
+                }
+
+                char* end;
+                value = std::strtod(token, &end);
+                return end == token + length;
+#endif
+            }
+
+
+            inline bool
+            parse(char* token, std::size_t length, std::size_t& value) noexcept
+            {
+                if (token[0] == '-' || token[0] == '+') {
+                    return false;
+                }
+#ifdef DISTR_HAS_TO_CHARS
+                auto const result = std::from_chars(token, token + length, value);
+                return result.ec == std::errc{} && result.ptr == token + length;
+#else
+                errno = 0;
+                char* end;
+                auto const parsed = std::strtoull(token, &end, 10);
+                if (errno != 0 || end != token + length ||
+                    parsed > static_cast<unsigned long long>(std::size_t(-1))) {
+                    return false;
+                }
+                value = std::size_t(parsed);
+                return true;
+#endif
+            }
+
+
+            /*
+             * Reads a number from a stream buffer. `token` is scratch space.
+             */
+            template<typename Char, typename Tr, typename T>
+            bool
+            read(
+                std::basic_streambuf<Char, Tr>& buf,
+                T& value,
+                std::string& token,
+                std::ios_base::iostate& state
+            )
+            {
+                auto const length = read_token(buf, token, state);
+
+                if (length == 0) {
+                    return false;
+                }
+                if (!parse(&token[0], length, value)) {
+                    state |= std::ios_base::failbit;
+                    return false;
+                }
+                return true;
+            }
+
+
+            /*
+             * Grisu2 algorithm of F. Loitsch, "Printing floating-point
+             * numbers quickly and accurately with integers" (PLDI 2010).
+             * Generates decimal digits of a positive finite double using
+             * 64-bit integer arithmetic only. The digits always read back to
+             * the same double, and they are the shortest such digits for
+             * all but a tiny fraction of doubles, where one more digit may
+             * be produced.
+             */
+            namespace grisu
+            {
+                // Floating-point number f * 2^e with a 64-bit significand.
+                struct diy_fp
+                {
+                    std::uint64_t f;
+                    int e;
+                };
+
+
+                inline diy_fp
+                sub(diy_fp x, diy_fp y) noexcept
+                {
+                    return {x.f - y.f, x.e};
+                }
+
+
+                // Returns x * y rounded to 64 bits.
+                inline diy_fp
+                mul(diy_fp x, diy_fp y) noexcept
+                {
+                    std::uint64_t const mask = 0xFFFFFFFF;
+
+                    auto const x_lo = x.f & mask;
+                    auto const x_hi = x.f >> 32;
+                    auto const y_lo = y.f & mask;
+                    auto const y_hi = y.f >> 32;
+
+                    auto const p0 = x_lo * y_lo;
+                    auto const p1 = x_lo * y_hi;
+                    auto const p2 = x_hi * y_lo;
+                    auto const p3 = x_hi * y_hi;
+
+                    auto const mid = (p0 >> 32) + (p1 & mask) + (p2 & mask) + (std::uint64_t(1) << 31);
+                    auto const high = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+
+                    return {high, x.e + y.e + 64};
+                }
+
+
+                inline diy_fp
+                normalize(diy_fp x) noexcept
+                {
+                    while ((x.f >> 63) == 0) {
+                        x.f <<= 1;
+                        x.e--;
+                    }
+                    return x;
+                }
+
+
+                // The value v and the boundaries m- and m+ of the interval of
+                // reals that round to v, normalized to a common exponent.
+                struct boundaries
+                {
+                    diy_fp v;
+                    diy_fp minus;
+                    diy_fp plus;
+                };
+
+
+                inline boundaries
+                compute_boundaries(double value) noexcept
+                {
+                    int const exponent_bias = 1075;
+                    std::uint64_t const hidden_bit = std::uint64_t(1) << 52;
+
+                    std::uint64_t bits;
+                    std::memcpy(&bits, &value, sizeof bits);
+
+                    auto const biased_exponent = int(bits >> 52);
+                    auto const fraction = bits & (hidden_bit - 1);
+
+                    auto const v = biased_exponent == 0
+                        ? diy_fp{fraction, 1 - exponent_bias}
+                        : diy_fp{fraction + hidden_bit, biased_exponent - exponent_bias};
+
+                    // The lower boundary is closer if v is a power of two
+                    // other than the smallest normal number.
+                    auto const lower_is_closer = fraction == 0 && biased_exponent > 1;
+
+                    diy_fp const m_plus = {2 * v.f + 1, v.e - 1};
+                    diy_fp const m_minus = lower_is_closer
+                        ? diy_fp{4 * v.f - 1, v.e - 2}
+                        : diy_fp{2 * v.f - 1, v.e - 1};
+
+                    auto const plus = normalize(m_plus);
+                    diy_fp const minus = {m_minus.f << (m_minus.e - plus.e), plus.e};
+
+                    return {normalize(v), minus, plus};
+                }
+
+
+                // Normalized approximation f * 2^e of 10^k.
+                struct cached_power
+                {
+                    std::uint64_t f;
+                    int e;
+                    int k;
+                };
+
+
+                // Returns a power of ten c such that the binary exponent of
+                // the product of c and a number with binary exponent e is in
+                // [-60, -32].
+                inline cached_power
+                cached_power_for(int e) noexcept
+                {
+                    static constexpr cached_power powers[] = {
+                        {0xAB70FE17C79AC6CA, -1060, -300},
+                        {0xFF77B1FCBEBCDC4F, -1034, -292},
+                        {0xBE5691EF416BD60C, -1007, -284},
+                        {0x8DD01FAD907FFC3C,  -980, -276},
+                        {0xD3515C2831559A83,  -954, -268},
+                        {0x9D71AC8FADA6C9B5,  -927, -260},
+                        {0xEA9C227723EE8BCB,  -901, -252},
+                        {0xAECC49914078536D,  -874, -244},
+                        {0x823C12795DB6CE57,  -847, -236},
+                        {0xC21094364DFB5637,  -821, -228},
+                        {0x9096EA6F3848984F,  -794, -220},
+                        {0xD77485CB25823AC7,  -768, -212},
+                        {0xA086CFCD97BF97F4,  -741, -204},
+                        {0xEF340A98172AACE5,  -715, -196},
+                        {0xB23867FB2A35B28E,  -688, -188},
+                        {0x84C8D4DFD2C63F3B,  -661, -180},
+                        {0xC5DD44271AD3CDBA,  -635, -172},
+                        {0x936B9FCEBB25C996,  -608, -164},
+                        {0xDBAC6C247D62A584,  -582, -156},
+                        {0xA3AB66580D5FDAF6,  -555, -148},
+                        {0xF3E2F893DEC3F126,  -529, -140},
+                        {0xB5B5ADA8AAFF80B8,  -502, -132},
+                        {0x87625F056C7C4A8B,  -475, -124},
+                        {0xC9BCFF6034C13053,  -449, -116},
+                        {0x964E858C91BA2655,  -422, -108},
+                        {0xDFF9772470297EBD,  -396, -100},
+                        {0xA6DFBD9FB8E5B88F,  -369,  -92},
+                        {0xF8A95FCF88747D94,  -343,  -84},
+                        {0xB94470938FA89BCF,  -316,  -76},
+                        {0x8A08F0F8BF0F156B,  -289,  -68},
+                        {0xCDB02555653131B6,  -263,  -60},
+                        {0x993FE2C6D07B7FAC,  -236,  -52},
+                        {0xE45C10C42A2B3B06,  -210,  -44},
+                        {0xAA242499697392D3,  -183,  -36},
+                        {0xFD87B5F28300CA0E,  -157,  -28},
+                        {0xBCE5086492111AEB,  -130,  -20},
+                        {0x8CBCCC096F5088CC,  -103,  -12},
+                        {0xD1B71758E219652C,   -77,   -4},
+                        {0x9C40000000000000,   -50,    4},
+                        {0xE8D4A51000000000,   -24,   12},
+                        {0xAD78EBC5AC620000,     3,   20},
+                        {0x813F3978F8940984,    30,   28},
+                        {0xC097CE7BC90715B3,    56,   36},
+                        {0x8F7E32CE7BEA5C70,    83,   44},
+                        {0xD5D238A4ABE98068,   109,   52},
+                        {0x9F4F2726179A2245,   136,   60},
+                        {0xED63A231D4C4FB27,   162,   68},
+                        {0xB0DE65388CC8ADA8,   189,   76},
+                        {0x83C7088E1AAB65DB,   216,   84},
+                        {0xC45D1DF942711D9A,   242,   92},
+                        {0x924D692CA61BE758,   269,  100},
+                        {0xDA01EE641A708DEA,   295,  108},
+                        {0xA26DA3999AEF774A,   322,  116},
+                        {0xF209787BB47D6B85,   348,  124},
+                        {0xB454E4A179DD1877,   375,  132},
+                        {0x865B86925B9BC5C2,   402,  140},
+                        {0xC83553C5C8965D3D,   428,  148},
+                        {0x952AB45CFA97A0B3,   455,  156},
+                        {0xDE469FBD99A05FE3,   481,  164},
+                        {0xA59BC234DB398C25,   508,  172},
+                        {0xF6C69A72A3989F5C,   534,  180},
+                        {0xB7DCBF5354E9BECE,   561,  188},
+                        {0x88FCF317F22241E2,   588,  196},
+                        {0xCC20CE9BD35C78A5,   614,  204},
+                        {0x98165AF37B2153DF,   641,  212},
+                        {0xE2A0B5DC971F303A,   667,  220},
+                        {0xA8D9D1535CE3B396,   694,  228},
+                        {0xFB9B7CD9A4A7443C,   720,  236},
+                        {0xBB764C4CA7A44410,   747,  244},
+                        {0x8BAB8EEFB6409C1A,   774,  252},
+                        {0xD01FEF10A657842C,   800,  260},
+                        {0x9B10A4E5E9913129,   827,  268},
+                        {0xE7109BFBA19C0C9D,   853,  276},
+                        {0xAC2820D9623BF429,   880,  284},
+                        {0x80444B5E7AA7CF85,   907,  292},
+                        {0xBF21E44003ACDD2D,   933,  300},
+                        {0x8E679C2F5E44FF8F,   960,  308},
+                        {0xD433179D9C8CB841,   986,  316},
+                        {0x9E19DB92B4E31BA9,  1013,  324}
+                    };
+
+                    int const alpha = -60;
+                    int const f = alpha - e - 1;
+                    int const k = (f * 78913) / (1 << 18) + int(f > 0);
+
+                    return powers[std::size_t((300 + k + 7) / 8)];
+                }
+
+
+                // Returns the number of decimal digits of n and the largest
+                // power of ten not exceeding n.
+                inline int
+                largest_pow10(std::uint32_t n, std::uint32_t& pow10) noexcept
+                {
+                    int digits = 10;
+                    pow10 = 1000000000;
+
+                    while (digits > 1 && n < pow10) {
+                        pow10 /= 10;
+                        digits--;
+                    }
+                    return digits;
+                }
+
+
+                // Moves the last digit toward w while it stays in the
+                // interval, to get the digits closest to the value.
+                inline void
+                round_weed(
+                    char* digits,
+                    int length,
+                    std::uint64_t dist,
+                    std::uint64_t delta,
+                    std::uint64_t rest,
+                    std::uint64_t ten_k
+                ) noexcept
+                {
+                    while (rest < dist && delta - rest >= ten_k &&
+                           (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+                        digits[length - 1]--;
+                        rest += ten_k;
+                    }
+                }
+
+
+                // Generates the shortest digits of a number in (M-, M+),
+                // choosing those closest to w.
+                inline void
+                generate_digits(
+                    char* digits,
+                    int& length,
+                    int& exponent,
+                    diy_fp m_minus,
+                    diy_fp w,
+                    diy_fp m_plus
+                ) noexcept
+                {
+                    auto delta = sub(m_plus, m_minus).f;
+                    auto dist = sub(m_plus, w).f;
+
+                    // Split M+ into integral part p1 and fraction part p2.
+                    auto const shift = -m_plus.e;
+                    auto const one = std::uint64_t(1) << shift;
+
+                    auto p1 = std::uint32_t(m_plus.f >> shift);
+                    auto p2 = m_plus.f & (one - 1);
+
+                    std::uint32_t pow10;
+                    auto n = largest_pow10(p1, pow10);
+
+                    while (n > 0) {
+                        digits[length++] = char('0' + p1 / pow10);
+                        p1 %= pow10;
+                        n--;
+
+                        auto const rest = (std::uint64_t(p1) << shift) + p2;
+                        if (rest <= delta) {
+                            exponent += n;
+                            round_weed(digits, length, dist, delta, rest, std::uint64_t(pow10) << shift);
+                            return;
+                        }
+                        pow10 /= 10;
+                    }
+
+                    for (;;) {
+                        p2 *= 10;
+                        digits[length++] = char('0' + (p2 >> shift));
+                        p2 &= one - 1;
+                        exponent--;
+
+                        delta *= 10;
+                        dist *= 10;
+                        if (p2 <= delta) {
+                            break;
+                        }
+                    }
+
+                    round_weed(digits, length, dist, delta, p2, one);
+                }
+
+
+                /*
+                 * Generates decimal digits d such that d * 10^exponent is the
+                 * shortest representation of a positive finite value.
+                 * `digits` must have 17 bytes.
+                 */
+                inline void
+                grisu2(char* digits, int& length, int& exponent, double value) noexcept
+                {
+                    auto const b = compute_boundaries(value);
+                    auto const cached = cached_power_for(b.plus.e);
+                    diy_fp const c = {cached.f, cached.e};
+
+                    auto const w = mul(b.v, c);
+                    auto const w_minus = mul(b.minus, c);
+                    auto const w_plus = mul(b.plus, c);
+
+                    // Shrink the interval by one ulp for the rounding errors
+                    // of the multiplications.
+                    diy_fp const m_minus = {w_minus.f + 1, w_minus.e};
+                    diy_fp const m_plus = {w_plus.f - 1, w_plus.e};
+
+                    length = 0;
+                    exponent = -cached.k;
+                    generate_digits(digits, length, exponent, m_minus, w, m_plus);
+                }
+
+
+                /*
+                 * Writes digits * 10^exponent in the fixed or the scientific
+                 * notation, whichever is shorter, in the same style as
+                 * std::to_chars.
+                 *
+                 * Returns:
+                 *   The number of characters written.
+                 */
+                inline std::size_t
+                write_decimal(char* buffer, char const* digits, int length, int exponent) noexcept
+                {
+                    auto const point = length + exponent;
+                    auto const fixed_length =
+                        exponent >= 0 ? point :
+                        point > 0     ? length + 1 :
+                                        2 - point + length;
+
+                    auto const sci_exponent = point - 1;
+                    auto const abs_exponent = sci_exponent < 0 ? -sci_exponent : sci_exponent;
+                    auto const sci_length =
+                        length + int(length > 1) + 2 + (abs_exponent >= 100 ? 3 : 2);
+
+                    char* out = buffer;
+
+                    if (fixed_length <= sci_length) {
+                        if (exponent >= 0) {
+                            out = std::copy(digits, digits + length, out);
+                            out = std::fill_n(out, exponent, '0');
+                        } else if (point > 0) {
+                            out = std::copy(digits, digits + point, out);
+                            *out++ = '.';
+                            out = std::copy(digits + point, digits + length, out);
+                        } else {
+                            *out++ = '0';
+                            *out++ = '.';
+                            out = std::fill_n(out, -point, '0');
+                            out = std::copy(digits, digits + length, out);
+                        }
+                    } else {
+                        *out++ = digits[0];
+                        if (length > 1) {
+                            *out++ = '.';
+                            out = std::copy(digits + 1, digits + length, out);
+                        }
+                        *out++ = 'e';
+                        *out++ = sci_exponent < 0 ? '-' : '+';
+                        if (abs_exponent >= 100) {
+                            *out++ = char('0' + abs_exponent / 100);
+                        }
+                        *out++ = char('0' + abs_exponent / 10 % 10);
+                        *out++ = char('0' + abs_exponent % 10);
+                    }
+
+                    return std::size_t(out - buffer);
+                }
+            }
+
+
+            /*
+             * Formats a number in the shortest form that parses back to the
+             * same value, independent of the locale. `buffer` must have
+             * `format_capacity` bytes.
+             *
+             * Returns:
+             *   The number of characters written.
+             */
+            inline std::size_t
+            format_shortest(char* buffer, double value) noexcept
+            {
+                char* out = buffer;
+
+                if (std::signbit(value)) {
+                    *out++ = '-';
+                    value = -value;
+                }
+
+                if (std::isnan(value) || std::isinf(value)) {
+                    char const* const text = std::isnan(value) ? "nan" : "inf";
+                    return std::size_t(std::copy(text, text + 3, out) - buffer);
+                }
+                if (value == 0) {
+                    *out++ = '0';
+                    return std::size_t(out - buffer);
+                }
+
+                char digits[17];
+                int length;
+                int exponent;
+                grisu::grisu2(digits, length, exponent, value);
+
+                return std::size_t(out - buffer) + grisu::write_decimal(out, digits, length, exponent);
+            }
+
+
+            /*
+             * Formats a number in the shortest form that parses back to the
+             * same value. `buffer` must have `format_capacity` bytes.
+             *
+             * Returns:
+             *   The number of characters written.
+             */
+            inline std::size_t
+            format(char* buffer, double value) noexcept
+            {
+#ifdef DISTR_HAS_TO_CHARS
+                auto const result = std::to_chars(buffer, buffer + format_capacity, value);
+                return std::size_t(result.ptr - buffer);
+#else
+                return format_shortest(buffer, value);
+#endif
+            }
+
+
+            template<typename Char, typename Tr>
+            void
+            write(std::basic_ostream<Char, Tr>& os, char const* text, std::size_t length)
+            {
+                for (std::size_t i = 0; i < length; i++) {
+                    os.put(os.widen(text[i]));
+                }
+            }
+
+
+            template<typename Tr>
+            void
+            write(std::basic_ostream<char, Tr>& os, char const* text, std::size_t length)
+            {
+                os.write(text, std::streamsize(length));
+            }
+        }
+
+        /*
+         * Binary format of discrete_weights. A file consists of a 64-byte
+         * header followed by the sum tree array:
+         *
+         *   offset  size  field
+         *   0       8     magic "CXXDISTR"
+         *   8       4     endian tag 0x01020304 in writer's byte order
+         *   12      4     format version (1)
+         *   16      4     tree layout (0: implicit heap, children of node k
+         *                 are 2k+1 and 2k+2)
+         *   20      4     weight type (1: IEEE 754 binary64)
+         *   24      8     number of events
+         *   32      8     number of leaves (zero or a power of two)
+         *   40      24    reserved (zero)
+         *   64      8*M   sum tree where M = 2 * leaves - 1 (or 0)
+         *
+         * Integers and weights are stored in the writer's byte order. The
+         * reader detects a swapped byte order by the endian tag.
+         */
+        namespace binary_format
+        {
+            constexpr std::size_t header_size = 64;
+            constexpr std::size_t magic_size = 8;
+            constexpr std::uint32_t endian_tag = 0x01020304;
+            constexpr std::uint32_t swapped_endian_tag = 0x04030201;
+            constexpr std::uint32_t version = 1;
+            constexpr std::uint32_t implicit_heap_layout = 0;
+            constexpr std::uint32_t binary64_weight = 1;
+
+
+            struct header
+            {
+                std::uint64_t events = 0;
+                std::uint64_t leaves = 0;
+                bool swapped = false;
+            };
+
+
+            inline char const*
+            magic() noexcept
+            {
+                return "CXXDISTR";
+            }
+
+
+            inline std::uint32_t
+            byteswap(std::uint32_t value) noexcept
+            {
+                return
+                    (value >> 24) |
+                    ((value >> 8) & 0x0000FF00U) |
+                    ((value << 8) & 0x00FF0000U) |
+                    (value << 24);
+            }
+
+
+            inline std::uint64_t
+            byteswap(std::uint64_t value) noexcept
+            {
+                return
+                    std::uint64_t(byteswap(std::uint32_t(value))) << 32 |
+                    byteswap(std::uint32_t(value >> 32));
+            }
+
+
+            inline void
+            byteswap(double* values, std::size_t count) noexcept
+            {
+                for (std::size_t i = 0; i < count; i++) {
+                    std::uint64_t bits;
+                    std::memcpy(&bits, values + i, sizeof bits);
+                    bits = byteswap(bits);
+                    std::memcpy(values + i, &bits, sizeof bits);
+                }
+            }
+
+
+            template<typename T>
+            void
+            put(char* buffer, std::size_t offset, T value) noexcept
+            {
+                std::memcpy(buffer + offset, &value, sizeof value);
+            }
+
+
+            template<typename T>
+            T
+            get(char const* buffer, std::size_t offset, bool swapped) noexcept
+            {
+                T value;
+                std::memcpy(&value, buffer + offset, sizeof value);
+                return swapped ? byteswap(value) : value;
+            }
+
+
+            /*
+             * Encodes a header into a buffer of `header_size` bytes.
+             */
+            inline void
+            encode(char* buffer, std::uint64_t events, std::uint64_t leaves) noexcept
+            {
+                std::memset(buffer, 0, header_size);
+                std::memcpy(buffer, magic(), magic_size);
+                put(buffer, 8, endian_tag);
+                put(buffer, 12, version);
+                put(buffer, 16, implicit_heap_layout);
+                put(buffer, 20, binary64_weight);
+                put(buffer, 24, events);
+                put(buffer, 32, leaves);
+            }
+
+
+            /*
+             * Decodes and validates a header. Returns false if the header is
+             * not a supported one.
+             */
+            inline bool
+            decode(char const* buffer, header& result) noexcept
+            {
+                static_assert(sizeof(double) == 8, "double must be binary64");
+
+                if (std::memcmp(buffer, magic(), magic_size) != 0) {
+                    return false;
+                }
+
+                auto const tag = get<std::uint32_t>(buffer, 8, false);
+                if (tag != endian_tag && tag != swapped_endian_tag) {
+                    return false;
+                }
+                auto const swapped = (tag == swapped_endian_tag);
+
+                if (get<std::uint32_t>(buffer, 12, swapped) != version ||
+                    get<std::uint32_t>(buffer, 16, swapped) != implicit_heap_layout ||
+                    get<std::uint32_t>(buffer, 20, swapped) != binary64_weight) {
+                    return false;
+                }
+
+                auto const events = get<std::uint64_t>(buffer, 24, swapped);
+                auto const leaves = get<std::uint64_t>(buffer, 32, swapped);
+
+                // Leaves must be a power of two not less than events, and
+                // the tree must be addressable.
+                if ((leaves & (leaves - 1)) != 0 || leaves < events) {
+                    return false;
+                }
+                if (leaves == 0 && events != 0) {
+                    return false;
+                }
+                if (leaves > std::uint64_t(-1) / 2 / sizeof(double) ||
+                    leaves > std::size_t(-1) / 2 / sizeof(double)) {
+                    return false;
+                }
+
+                result.events = events;
+                result.leaves = leaves;
+                result.swapped = swapped;
+
+                return true;
+            }
+
+
+            /*
+             * Returns the number of nodes of the sum tree with given leaves.
+             */
+            inline std::size_t
+            tree_size(std::uint64_t leaves) noexcept
+            {
+                return leaves == 0 ? 0 : std::size_t(2 * leaves - 1);
+            }
+
+
+            /*
+             * Returns the number of bytes left in a stream, or -1 if the
+             * stream is not seekable. The position is left unchanged.
+             */
+            inline std::streamoff
+            remaining(std::istream& is)
+            {
+                auto& buf = *is.rdbuf();
+                auto const current = buf.pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+                if (current == std::streampos(-1)) {
+                    return -1;
+                }
+                auto const end = buf.pubseekoff(0, std::ios_base::end, std::ios_base::in);
+                buf.pubseekpos(current, std::ios_base::in);
+                if (end == std::streampos(-1)) {
+                    return -1;
+                }
+                return std::streamoff(end - current);
+            }
+        }
+    }
+
+
+    // STORAGE ---------------------------------------------------------------
 
     /*
-     * Class holding the weights of a discrete distribution. It allows
+     * Storage policy of `basic_discrete_weights` that owns a dynamically
+     * allocated array.
+     *
+     * A storage policy is a class providing `data()` (const and non-const)
+     * and `size()` of a contiguous array of doubles. Storage that can be
+     * resized additionally provides `resize(n)`, which allows constructing
+     * weights from values.
+     *
+     * Memory is obtained from `Allocator`, e.g., an arena allocator or
+     * `std::pmr::polymorphic_allocator<double>`.
+     */
+    template<typename Allocator = std::allocator<double>>
+    class vector_storage
+    {
+        static_assert(
+            std::is_same<typename Allocator::value_type, double>::value,
+            "allocator must allocate doubles"
+        );
+
+    public:
+
+        using allocator_type = Allocator;
+
+
+        vector_storage() = default;
+
+
+        /*
+         * Creates an empty storage using given allocator.
+         */
+        explicit
+        vector_storage(Allocator const& alloc)
+            : _data(alloc)
+        {
+        }
+
+
+        /*
+         * Allocates a zero-filled array of given size.
+         */
+        explicit
+        vector_storage(std::size_t size, Allocator const& alloc = Allocator{})
+            : _data(size, 0.0, alloc)
+        {
+        }
+
+
+        /*
+         * Returns the allocator.
+         */
+        inline allocator_type
+        get_allocator() const
+        {
+            return _data.get_allocator();
+        }
+
+
+        inline double*
+        data() noexcept
+        {
+            return _data.data();
+        }
+
+
+        inline double const*
+        data() const noexcept
+        {
+            return _data.data();
+        }
+
+
+        inline std::size_t
+        size() const noexcept
+        {
+            return _data.size();
+        }
+
+
+        void
+        resize(std::size_t size)
+        {
+            _data.resize(size);
+        }
+
+
+    private:
+        std::vector<double, Allocator> _data;
+    };
+
+
+    /*
+     * Storage policy of `basic_discrete_weights` referring to an array owned
+     * by someone else. Copies of the storage refer to the same array.
+     */
+    class span_storage
+    {
+    public:
+
+        span_storage() = default;
+
+
+        /*
+         * Refers to an array.
+         *
+         * Params:
+         *   data     = Pointer to the first element.
+         *   capacity = Number of elements available. Use `required_storage`
+         *              to determine the capacity needed for a tree.
+         */
+        span_storage(double* data, std::size_t capacity) noexcept
+            : _data{data}
+            , _size{capacity}
+            , _capacity{capacity}
+        {
+        }
+
+
+        inline double*
+        data() noexcept
+        {
+            return _data;
+        }
+
+
+        inline double const*
+        data() const noexcept
+        {
+            return _data;
+        }
+
+
+        inline std::size_t
+        size() const noexcept
+        {
+            return _size;
+        }
+
+
+        inline std::size_t
+        capacity() const noexcept
+        {
+            return _capacity;
+        }
+
+
+        /*
+         * Uses the first `size` elements of the array. The size must not
+         * exceed the capacity.
+         */
+        void
+        resize(std::size_t size) noexcept
+        {
+            DISTR_ASSERT(size <= _capacity);
+            _size = size;
+        }
+
+
+    private:
+        double* _data = nullptr;
+        std::size_t _size = 0;
+        std::size_t _capacity = 0;
+    };
+
+
+    /*
+     * Returns the number of doubles needed to store the sum tree of given
+     * number of events, i.e., `2 * L - 1` where L is the smallest power of
+     * two not less than `events`.
+     *
+     * Throws:
+     *   std::length_error if the size does not fit in std::size_t.
+     */
+    inline std::size_t
+    required_storage(std::size_t events)
+    {
+        return 2 * detail::sumtree_leaves(events) - 1;
+    }
+
+
+#ifdef DISTR_STATS
+    // STATISTICS ------------------------------------------------------------
+
+    /*
+     * Counter of operations. The value is a relaxed atomic incremented by a
+     * load and a store instead of a read-modify-write. So const operations
+     * such as `find`, which may run concurrently, do not race on it and
+     * cost about as much as with a plain integer, but concurrent increments
+     * may be lost. Converts to std::uint64_t.
+     */
+    class stats_counter
+    {
+    public:
+
+        stats_counter() = default;
+
+
+        stats_counter(stats_counter const& other) noexcept
+            : _value{other}
+        {
+        }
+
+
+        stats_counter&
+        operator=(stats_counter const& other) noexcept
+        {
+            _value.store(other, std::memory_order_relaxed);
+            return *this;
+        }
+
+
+        inline
+        operator std::uint64_t() const noexcept
+        {
+            return _value.load(std::memory_order_relaxed);
+        }
+
+
+        /*
+         * Increments the counter and returns the previous value.
+         */
+        inline std::uint64_t
+        operator++(int) noexcept
+        {
+            return add(1);
+        }
+
+
+        inline stats_counter&
+        operator+=(std::uint64_t n) noexcept
+        {
+            add(n);
+            return *this;
+        }
+
+
+    private:
+
+        std::uint64_t
+        add(std::uint64_t n) noexcept
+        {
+            auto const value = _value.load(std::memory_order_relaxed);
+            _value.store(value + n, std::memory_order_relaxed);
+            return value;
+        }
+
+
+    private:
+        std::atomic<std::uint64_t> _value{0};
+    };
+
+
+    /*
+     * Histogram of operation latencies in nanoseconds. Bucket k counts
+     * latencies in [2^k, 2^(k+1)) ns; bucket 0 also counts latencies below
+     * 1 ns and the last bucket also counts longer latencies.
+     */
+    class latency_histogram
+    {
+    public:
+
+        /*
+         * Number of buckets.
+         */
+        static constexpr std::size_t buckets = 40;
+
+
+        /*
+         * Adds a latency to the histogram.
+         */
+        void
+        record(std::uint64_t nanoseconds) noexcept
+        {
+            _sum += nanoseconds;
+
+            std::size_t bucket = 0;
+            while (nanoseconds > 1 && bucket + 1 < buckets) {
+                nanoseconds >>= 1;
+                bucket++;
+            }
+            _counts[bucket] += 1;
+        }
+
+
+        /*
+         * Returns the number of latencies in the bucket.
+         */
+        inline std::uint64_t
+        count(std::size_t bucket) const noexcept
+        {
+            DISTR_ASSERT(bucket < buckets);
+            return _counts[bucket];
+        }
+
+
+        /*
+         * Returns the number of latencies in the histogram.
+         */
+        std::uint64_t
+        total() const noexcept
+        {
+            std::uint64_t sum = 0;
+            for (auto const& count : _counts) {
+                sum += count;
+            }
+            return sum;
+        }
+
+
+        /*
+         * Returns the mean latency in nanoseconds, or zero if the histogram
+         * is empty.
+         */
+        double
+        mean() const noexcept
+        {
+            auto const n = total();
+            if (n == 0) {
+                return 0;
+            }
+            return double(_sum) / double(n);
+        }
+
+
+        /*
+         * Returns an upper bound of the q-quantile of the latencies in
+         * nanoseconds, i.e., the upper end of the bucket containing it.
+         * Returns zero if the histogram is empty.
+         */
+        std::uint64_t
+        quantile(double q) const noexcept
+        {
+            auto const n = total();
+            if (n == 0) {
+                return 0;
+            }
+
+            auto const rank = std::uint64_t(q * double(n - 1));
+            std::uint64_t cumulative = 0;
+            std::size_t bucket = 0;
+
+            for (; bucket + 1 < buckets; bucket++) {
+                cumulative += _counts[bucket];
+                if (cumulative > rank) {
+                    break;
+                }
+            }
+
+            return std::uint64_t(1) << (bucket + 1);
+        }
+
+
+    private:
+        stats_counter _counts[buckets];
+        stats_counter _sum;
+    };
+
+
+    /*
+     * Statistics collected by discrete_weights when DISTR_STATS is defined.
+     * Latencies are measured with std::chrono::steady_clock and include its
+     * overhead. Only every DISTR_STATS_LATENCY_PERIOD-th call, starting from
+     * the first, is timed. Counts may miss calls of `find` made concurrently
+     * from multiple threads (see `stats_counter`).
+     */
+    struct discrete_weights_stats
+    {
+        // Number of calls to `update`.
+        stats_counter updates;
+
+        // Number of internal nodes recomputed by `update`.
+        stats_counter update_levels;
+
+        // Number of calls to `find`. Every sample of discrete_distribution
+        // calls `find` once.
+        stats_counter finds;
+
+        // Number of tree levels descended by `find`.
+        stats_counter find_levels;
+
+        // Number of `find` results clamped to the last event because the
+        // search overshot due to rounding errors.
+        stats_counter find_clamps;
+
+        // Number of O(N) rebuilds of the internal nodes, including those by
+        // the constructors, `refresh` and text input.
+        stats_counter rebuilds;
+
+        latency_histogram update_latency;
+        latency_histogram find_latency;
+    };
+
+
+    namespace detail
+    {
+        /*
+         * Operations are timed once per this many calls, since reading the
+         * clock costs about as much as a search in a small tree.
+         */
+#ifdef DISTR_STATS_LATENCY_PERIOD
+        constexpr std::uint64_t latency_period = DISTR_STATS_LATENCY_PERIOD;
+#else
+        constexpr std::uint64_t latency_period = 16;
+#endif
+
+        static_assert(
+            latency_period > 0 && (latency_period & (latency_period - 1)) == 0,
+            "DISTR_STATS_LATENCY_PERIOD must be a power of two"
+        );
+
+
+        // Returns true if the call with given sequence number is timed.
+        inline bool
+        sample_latency(std::uint64_t call) noexcept
+        {
+            return (call & (latency_period - 1)) == 0;
+        }
+
+
+        // Records the lifetime of the object to a histogram if active.
+        class latency_timer
+        {
+            using clock = std::chrono::steady_clock;
+
+        public:
+            latency_timer(cxx::latency_histogram& histogram, bool active) noexcept
+                : _histogram{histogram}, _active{active}
+            {
+                if (_active) {
+                    _start = clock::now();
+                }
+            }
+
+            ~latency_timer()
+            {
+                if (!_active) {
+                    return;
+                }
+                auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - _start
+                );
+                _histogram.record(std::uint64_t(elapsed.count()));
+            }
+
+            latency_timer(latency_timer const&) = delete;
+            latency_timer& operator=(latency_timer const&) = delete;
+
+        private:
+            cxx::latency_histogram& _histogram;
+            bool _active;
+            clock::time_point _start;
+        };
+    }
+#endif
+
+
+    // WEIGHTS ---------------------------------------------------------------
+
+    /*
+     * Class holding the weights of a discrete distribution. It allows
      * efficient reweighting and searching.
+     *
+     * The sum tree is kept in an array provided by `Storage`. Use the alias
+     * `cxx::discrete_weights` for the usual self-contained object.
      */
-    class discrete_weights
+    template<typename Storage>
+    class basic_discrete_weights
     {
     public:
 
-        using pointer = double const*;
-        using iterator = double const*;
+        using storage_type = Storage;
+        using pointer = double const*;
+        using iterator = double const*;
+
+
+        /*
+         * Default constructor creates an empty object.
+         */
+        basic_discrete_weights() = default;
+
+
+        /*
+         * Sets weight values from a vector.
+         *
+         * Params:
+         *   weights = Weight values. The weights must be non-negative finite
+         *             numbers.
+         *
+         * Time complexity:
+         *   O(N) where N is the number of events (= `weights.size()`).
+         */
+        explicit
+        basic_discrete_weights(std::vector<double> const& weights)
+        {
+            // Construct a complete binary tree in which the leaves contain
+            // the weights and internal nodes contain the sums of the weights
+            // of children.
+            allocate(weights.size());
+
+            auto const leaves = _storage.data() + _leaves - 1;
+
+            for (std::size_t i = 0; i < _events; i++) {
+                leaves[i] = weights[i];
+            }
+
+            build();
+        }
 
 
         /*
-         * Default constructor creates an empty object.
+         * Sets weight values from an initializer list.
+         *
+         * Params:
+         *   weights = Weight values. The weights must be non-negative finite
+         *             numbers.
          */
-        discrete_weights() = default;
+        basic_discrete_weights(std::initializer_list<double> const& weights)
+            : basic_discrete_weights{std::vector<double>{weights}}
+        {
+        }
 
 
         /*
-         * Sets weight values from a vector.
+         * Builds the sum tree of given weights in given storage.
          *
          * Params:
+         *   storage = Storage to build the tree in. It must be able to hold
+         *             `required_storage(weights.size())` elements.
          *   weights = Weight values. The weights must be non-negative finite
          *             numbers.
          *
          * Time complexity:
          *   O(N) where N is the number of events (= `weights.size()`).
          */
-        explicit
-        discrete_weights(std::vector<double> const& weights)
+        basic_discrete_weights(Storage storage, std::vector<double> const& weights)
+            : _storage{std::move(storage)}
         {
-            // Construct a complete binary tree in which the leaves contain
-            // the weights and internal nodes contain the sums of the weights
-            // of children.
+            allocate(weights.size());
 
-            // Determine the number of leaves.
-            std::size_t leaves = 1;
-
-            for (;;) {
-                if (leaves >= weights.size()) {
-                    break;
-                }
-                leaves *= 2;
-            }
-
-            // We store the binary tree as an array using the usual scheme:
-            //
-            //   root = 0 ,
-            //   parent(node) = (node - 1) / 2 .
-            //
-            _sumtree.resize(leaves * 2 - 1);
-            _leaves = leaves;
-            _events = weights.size();
-            DISTR_ASSERT(_leaves >= _events);
+            auto const leaves = _storage.data() + _leaves - 1;
 
-            // Fill the leaves.
             for (std::size_t i = 0; i < _events; i++) {
-                _sumtree[_leaves + i - 1] = weights[i];
+                leaves[i] = weights[i];
             }
 
-            // Then, fill internal nodes from leaves to the root. Recall
-            // that each node contains the sum of the weights of its
-            // children.
-            for (std::size_t layer = 1; ; layer++) {
-                auto const layer_size = leaves >> layer;
-                if (layer_size == 0) {
-                    break;
-                }
-
-                auto const start = layer_size - 1;
-                auto const end = start + layer_size;
-
-                DISTR_ASSERT(end < _leaves);
-                DISTR_ASSERT(start < end);
-
-                for (std::size_t node = start; node < end; node++) {
-                    auto const lchild = 2 * node + 1;
-                    auto const rchild = 2 * node + 2;
-                    _sumtree[node] = _sumtree[lchild] + _sumtree[rchild];
-                }
-            }
+            build();
         }
 
 
         /*
-         * Sets weight values from an initializer list.
+         * Adopts storage already containing a complete sum tree, e.g., one
+         * loaded by `read_binary` or mapped from a file. The tree is used
+         * as is without validation.
          *
          * Params:
-         *   weights = Weight values. The weights must be non-negative finite
-         *             numbers.
+         *   storage = Storage containing `2 * leaves - 1` nodes, or none if
+         *             `leaves` is zero.
+         *   events  = Number of events.
+         *   leaves  = Number of leaves. Must be zero or a power of two not
+         *             less than `events`.
+         *
+         * Time complexity:
+         *   O(1) plus the cost of moving `storage`.
          */
-        discrete_weights(std::initializer_list<double> const& weights)
-            : discrete_weights{std::vector<double>{weights}}
+        basic_discrete_weights(Storage storage, std::size_t events, std::size_t leaves)
+            : _storage{std::move(storage)}
+            , _leaves{leaves}
+            , _events{events}
         {
+            DISTR_ASSERT(_leaves >= _events);
+            DISTR_ASSERT((_leaves & (_leaves - 1)) == 0);
+            DISTR_ASSERT(_storage.size() == (_leaves == 0 ? 0 : 2 * _leaves - 1));
         }
 
 
@@ -165,13 +1611,25 @@ namespace cxx
         }
 
 
+        /*
+         * Returns the number of leaves of the sum tree. It is the smallest
+         * power of two not less than `size()`, or zero for a
+         * default-constructed object.
+         */
+        inline std::size_t
+        leaves() const noexcept
+        {
+            return _leaves;
+        }
+
+
         /*
          * Returns a pointer to the array containing weight values.
          */
         inline pointer
         data() const noexcept
         {
-            return _sumtree.data() + _leaves - 1;
+            return _storage.data() + _leaves - 1;
         }
 
 
@@ -207,6 +1665,52 @@ namespace cxx
         }
 
 
+        /*
+         * Returns the storage holding the sum tree. The array contains
+         * `2 * leaves() - 1` nodes: the root at index 0, and the children
+         * of node k at `2k+1` and `2k+2`.
+         */
+        inline Storage const&
+        storage() const noexcept
+        {
+            return _storage;
+        }
+
+
+        /*
+         * Returns the storage holding the sum tree. Modifying the array
+         * invalidates the sums unless the tree invariant is maintained.
+         */
+        inline Storage&
+        storage() noexcept
+        {
+            return _storage;
+        }
+
+#ifdef DISTR_STATS
+
+        /*
+         * Returns the statistics of the operations on this object. Available
+         * only if DISTR_STATS is defined.
+         */
+        inline discrete_weights_stats const&
+        stats() const noexcept
+        {
+            return _stats;
+        }
+
+
+        /*
+         * Clears the statistics.
+         */
+        void
+        reset_stats() noexcept
+        {
+            _stats = discrete_weights_stats{};
+        }
+#endif
+
+
         /*
          * Returns the sum of the weights.
          *
@@ -216,7 +1720,7 @@ namespace cxx
         inline double
         sum() const
         {
-            return _sumtree[0];
+            return _leaves == 0 ? 0 : _storage.data()[0];
         }
 
 
@@ -239,16 +1743,42 @@ namespace cxx
         {
             DISTR_ASSERT(i < _events);
             DISTR_ASSERT(weight >= 0);
+            DISTR_STATS_ONLY(auto const call = _stats.updates++);
+            DISTR_STATS_ONLY(detail::latency_timer timer(_stats.update_latency, detail::sample_latency(call)));
+            DISTR_STATS_ONLY(std::uint64_t levels = 0);
 
+            auto const tree = _storage.data();
             auto node = _leaves + i - 1;
-            _sumtree[node] = weight;
+            tree[node] = weight;
 
-            do {
+            while (node > 0) {
+                DISTR_STATS_ONLY(levels++);
                 node = (node - 1) / 2;
                 auto const lchild = 2 * node + 1;
                 auto const rchild = 2 * node + 2;
-                _sumtree[node] = _sumtree[lchild] + _sumtree[rchild];
-            } while (node > 0);
+                tree[node] = tree[lchild] + tree[rchild];
+            }
+
+            DISTR_STATS_ONLY(_stats.update_levels += levels);
+        }
+
+
+        /*
+         * Recomputes the sums of the tree from the weights, e.g., after the
+         * weights are written directly through `storage()`.
+         *
+         * Rounding errors do not accumulate over `update` calls, since each
+         * call recomputes the sums on the path from their children. So the
+         * tree after any sequence of updates is identical to the rebuilt one
+         * and refreshing it periodically is unnecessary.
+         *
+         * Time complexity:
+         *   O(N) where N is the number of events.
+         */
+        void
+        refresh() noexcept
+        {
+            build();
         }
 
 
@@ -270,7 +1800,8 @@ namespace cxx
          *   probe = Probe weight used to find an event.
          *
          * Returns:
-         *   The index of the event found.
+         *   The index of the event found, or `size_t(-1)` if there is no
+         *   event.
          *
          * Time complexity:
          *   O(log N) where N is the number of events.
@@ -278,44 +1809,145 @@ namespace cxx
         std::size_t
         find(double probe) const
         {
+            DISTR_STATS_ONLY(auto const call = _stats.finds++);
+            DISTR_STATS_ONLY(detail::latency_timer timer(_stats.find_latency, detail::sample_latency(call)));
+            DISTR_STATS_ONLY(std::uint64_t levels = 0);
+
+            // A default-constructed object has no tree to search.
+            if (_leaves == 0) {
+                return std::size_t(-1);
+            }
+
+            auto const tree = _storage.data();
+            auto const tree_size = 2 * _leaves - 1;
             std::size_t node = 0;
 
-            for (;;) {
-                auto const lchild = 2 * node + 1;
-                auto const rchild = 2 * node + 2;
+            if (_leaves <= detail::branchless_leaves) {
+                // A small tree stays in cache, where mispredicted branches
+                // dominate the cost. Choose the child arithmetically. The
+                // result is the same as the branching search below.
+                for (;;) {
+                    auto const lchild = 2 * node + 1;
 
-                if (lchild >= _sumtree.size()) {
-                    break;
+                    if (lchild >= tree_size) {
+                        break;
+                    }
+                    DISTR_STATS_ONLY(levels++);
+
+                    auto const left = tree[lchild];
+                    auto const right = !(probe < left);
+                    probe -= left * double(right);
+                    node = lchild + std::size_t(right);
                 }
+            } else {
+                // A large tree misses cache. Branching lets the CPU
+                // speculatively load the next level, hiding the latency.
+                for (;;) {
+                    auto const lchild = 2 * node + 1;
+                    auto const rchild = 2 * node + 2;
 
-                if (probe < _sumtree[lchild]) {
-                    node = lchild;
-                } else {
-                    probe -= _sumtree[lchild];
-                    node = rchild;
+                    if (lchild >= tree_size) {
+                        break;
+                    }
+                    DISTR_STATS_ONLY(levels++);
+
+                    if (probe < tree[lchild]) {
+                        node = lchild;
+                    } else {
+                        probe -= tree[lchild];
+                        node = rchild;
+                    }
                 }
             }
 
+            DISTR_STATS_ONLY(_stats.find_levels += levels);
+
             DISTR_ASSERT(node >= _leaves - 1);
-            DISTR_ASSERT(node < _sumtree.size());
+            DISTR_ASSERT(node < tree_size);
             auto index = node - (_leaves - 1);
 
             // Search may overshoot due to numerical errors.
             if (index >= _events) {
+                DISTR_STATS_ONLY(_stats.find_clamps++);
                 index = _events - 1;
             }
 
             return index;
         }
+
+
+    private:
+
+        /*
+         * Resizes the storage to hold a tree of given number of events and
+         * zero-fills the leaves.
+         */
+        void
+        allocate(std::size_t events)
+        {
+            auto const leaves = detail::sumtree_leaves(events);
+
+            _storage.resize(leaves * 2 - 1);
+            _leaves = leaves;
+            _events = events;
+            DISTR_ASSERT(_leaves >= _events);
+
+            auto const tree = _storage.data();
+            for (std::size_t i = 0; i < _leaves; i++) {
+                tree[_leaves + i - 1] = 0;
+            }
+        }
+
+
+        /*
+         * Computes the internal nodes from the leaves.
+         */
+        void
+        build() noexcept
+        {
+            DISTR_STATS_ONLY(_stats.rebuilds++);
+            detail::build_sumtree(_storage.data(), _leaves);
+        }
+
+
     private:
-        std::vector<double> _sumtree;
+        Storage _storage;
         std::size_t _leaves = 0;
         std::size_t _events = 0;
+#ifdef DISTR_STATS
+        mutable discrete_weights_stats _stats;
+#endif
     };
 
 
+    /*
+     * Self-contained weights of a discrete distribution.
+     */
+    using discrete_weights = basic_discrete_weights<vector_storage<>>;
+
+
+    /*
+     * Weights whose sum tree lives in a caller-provided array, e.g., an
+     * arena, huge pages or shared memory. Copies refer to the same array.
+     *
+     * Example:
+     *
+     *   std::vector<double> const weights = {1.0, 2.0, 3.0};
+     *   double* buffer = arena.allocate(cxx::required_storage(3));
+     *
+     *   cxx::discrete_weights_view view{
+     *       cxx::span_storage{buffer, cxx::required_storage(3)}, weights
+     *   };
+     */
+    using discrete_weights_view = basic_discrete_weights<span_storage>;
+
+
+    template<typename S1, typename S2>
     inline bool
-    operator==(cxx::discrete_weights const& w1, cxx::discrete_weights const& w2)
+    operator==(
+        cxx::basic_discrete_weights<S1> const& w1,
+        cxx::basic_discrete_weights<S2> const& w2
+    )
     {
         if (w1.size() != w2.size()) {
             return false;
@@ -324,59 +1956,104 @@ namespace cxx
     }
 
 
+    template<typename S1, typename S2>
     inline bool
-    operator!=(cxx::discrete_weights const& w1, cxx::discrete_weights const& w2)
+    operator!=(
+        cxx::basic_discrete_weights<S1> const& w1,
+        cxx::basic_discrete_weights<S2> const& w2
+    )
     {
         return !(w1 == w2);
     }
 
 
-    template<typename Char, typename Tr>
+    /*
+     * Reads weights in the text form `N w[0] w[1] ... w[N-1]`. Numbers are
+     * parsed without locale, directly into the leaves of a new tree, and
+     * the tree is built once after all values are read.
+     *
+     * Sets failbit on malformed input, in which case `weights` is left
+     * unchanged.
+     */
+    template<typename Char, typename Tr, typename Allocator>
     std::basic_istream<Char, Tr>&
     operator>>(
         std::basic_istream<Char, Tr>& is,
-        cxx::discrete_weights& weights
+        cxx::basic_discrete_weights<cxx::vector_storage<Allocator>>& weights
     )
     {
+        using weights_type = cxx::basic_discrete_weights<cxx::vector_storage<Allocator>>;
         using sentry_type = typename std::basic_istream<Char, Tr>::sentry;
+        namespace text = detail::text_format;
 
         if (sentry_type sentry{is}) {
-            std::size_t size;
-            if (!(is >> size)) {
+            auto& buf = *is.rdbuf();
+            std::ios_base::iostate state = std::ios_base::goodbit;
+
+            std::string token;
+            std::size_t size = 0;
+            if (!text::read(buf, size, token, state)) {
+                is.setstate(state);
                 return is;
             }
 
-            std::vector<double> values(size);
-            for (auto& value : values) {
-                if (!(is >> value)) {
+            // Reject sizes whose tree the allocator cannot hold. The first
+            // test keeps required_storage from overflowing.
+            auto const alloc = weights.storage().get_allocator();
+            auto const max_nodes = std::allocator_traits<Allocator>::max_size(alloc);
+            if (size > max_nodes / 2 || cxx::required_storage(size) > max_nodes) {
+                is.setstate(state | std::ios_base::failbit);
+                return is;
+            }
+
+            // Parse directly into the leaves, then build the tree once.
+            auto const leaves = detail::sumtree_leaves(size);
+            cxx::vector_storage<Allocator> storage{cxx::required_storage(size), alloc};
+            auto const leaf_values = storage.data() + leaves - 1;
+
+            for (std::size_t i = 0; i < size; i++) {
+                if (!text::read(buf, leaf_values[i], token, state)) {
+                    is.setstate(state);
                     return is;
                 }
             }
 
-            weights = cxx::discrete_weights{values};
+            weights_type loaded{std::move(storage), size, leaves};
+            loaded.refresh();
+            weights = std::move(loaded);
+
+            is.setstate(state);
         }
 
         return is;
     }
 
 
-    template<typename Char, typename Tr>
+    /*
+     * Writes weights in the text form `N w[0] w[1] ... w[N-1]`. Each weight
+     * is written in the shortest form that reads back to the same value,
+     * regardless of the precision setting of the stream.
+     */
+    template<typename Char, typename Tr, typename Storage>
     std::basic_ostream<Char, Tr>&
     operator<<(
         std::basic_ostream<Char, Tr>& os,
-        cxx::discrete_weights const& weights
+        cxx::basic_discrete_weights<Storage> const& weights
     )
     {
         using sentry_type = typename std::basic_ostream<Char, Tr>::sentry;
 
+        namespace text = detail::text_format;
+
         if (sentry_type sentry{os}) {
             os << weights.size();
 
-            auto const sep = os.widen(' ');
+            char buffer[1 + text::format_capacity];
+            buffer[0] = ' ';
 
             for (auto weight : weights) {
-                os << sep;
-                os << weight;
+                auto const length = 1 + text::format(buffer + 1, weight);
+                text::write(os, buffer, length);
             }
         }
 
@@ -384,12 +2061,187 @@ namespace cxx
     }
 
 
+    /*
+     * Writes weights to a binary stream in the format described in
+     * `detail::binary_format`. The whole sum tree is written, so that
+     * `read_binary` restores the object without recomputation.
+     *
+     * Params:
+     *   os      = Output stream opened in binary mode.
+     *   weights = Weights to write.
+     *
+     * Returns:
+     *   `os`. Errors are reported through the stream state.
+     *
+     * Time complexity:
+     *   O(N) where N is the number of events.
+     */
+    template<typename Storage>
+    std::ostream&
+    write_binary(std::ostream& os, cxx::basic_discrete_weights<Storage> const& weights)
+    {
+        namespace format = detail::binary_format;
+
+        char header[format::header_size];
+        format::encode(header, weights.size(), weights.leaves());
+
+        os.write(header, sizeof header);
+        os.write(
+            reinterpret_cast<char const*>(weights.storage().data()),
+            std::streamsize(format::tree_size(weights.leaves()) * sizeof(double))
+        );
+
+        return os;
+    }
+
+
+    /*
+     * Reads weights written by `write_binary`. The sum tree is loaded in a
+     * single bulk read and is not rebuilt. Weights written on a machine of
+     * the opposite byte order are byte-swapped.
+     *
+     * Params:
+     *   is      = Input stream opened in binary mode.
+     *   weights = Object to store the weights. Unchanged on error.
+     *
+     * Returns:
+     *   `is`. Sets failbit if the header is invalid, the tree it declares
+     *   cannot be allocated or is longer than the rest of a seekable
+     *   stream, or the data is truncated.
+     *
+     * Time complexity:
+     *   O(N) where N is the number of events.
+     */
+    template<typename Allocator>
+    std::istream&
+    read_binary(
+        std::istream& is,
+        cxx::basic_discrete_weights<cxx::vector_storage<Allocator>>& weights
+    )
+    {
+        using weights_type = cxx::basic_discrete_weights<cxx::vector_storage<Allocator>>;
+        namespace format = detail::binary_format;
+
+        char buffer[format::header_size];
+        if (!is.read(buffer, sizeof buffer)) {
+            return is;
+        }
+
+        format::header header;
+        if (!format::decode(buffer, header)) {
+            is.setstate(std::ios_base::failbit);
+            return is;
+        }
+
+        // Check the declared size before allocating for it, so that a
+        // corrupted header fails instead of exhausting memory.
+        auto const nodes = format::tree_size(header.leaves);
+        auto const alloc = weights.storage().get_allocator();
+        auto const available = format::remaining(is);
+
+        if (nodes > std::allocator_traits<Allocator>::max_size(alloc) ||
+            (available >= 0 && std::uint64_t(available) / sizeof(double) < nodes)) {
+            is.setstate(std::ios_base::failbit);
+            return is;
+        }
+
+        // The length of an unseekable stream is unknown, so the tree is
+        // read in chunks and the storage grows only as data arrives.
+        std::size_t const chunk = available >= 0 ? nodes : std::size_t(1) << 16;
+
+        cxx::vector_storage<Allocator> storage{alloc};
+        while (storage.size() < nodes) {
+            auto const offset = storage.size();
+            auto const count = std::min(chunk, nodes - offset);
+
+            try {
+                storage.resize(offset + count);
+            } catch (std::bad_alloc const&) {
+                is.setstate(std::ios_base::failbit);
+                return is;
+            } catch (std::length_error const&) {
+                is.setstate(std::ios_base::failbit);
+                return is;
+            }
+
+            if (!is.read(
+                reinterpret_cast<char*>(storage.data() + offset),
+                std::streamsize(count * sizeof(double))
+            )) {
+                return is;
+            }
+        }
+
+        if (header.swapped) {
+            format::byteswap(storage.data(), storage.size());
+        }
+
+        weights = weights_type{
+            std::move(storage),
+            std::size_t(header.events),
+            std::size_t(header.leaves)
+        };
+
+        return is;
+    }
+
+
     // DISTRIBUTION ----------------------------------------------------------
 
+    namespace detail
+    {
+        /*
+         * Allocator type of a discrete_distribution with a custom backend.
+         * It is not an allocator.
+         */
+        struct no_allocator
+        {
+        };
+
+
+        /*
+         * Allocator of a discrete_distribution backend. Only the sum tree in
+         * memory obtained from an allocator has one.
+         */
+        template<typename Backend>
+        struct backend_allocator
+        {
+            using type = no_allocator;
+        };
+
+        template<typename Allocator>
+        struct backend_allocator<
+            cxx::basic_discrete_weights<cxx::vector_storage<Allocator>>
+        >
+        {
+            using type = Allocator;
+        };
+    }
+
+
     /*
      * Distribution of random integers with given weights.
+     *
+     * The second template argument is the backend that holds the weights.
+     * The default is the sum tree `cxx::discrete_weights`. To allocate the
+     * sum tree with a custom allocator A, use
+     * `cxx::basic_discrete_weights<cxx::vector_storage<A>>`. Any other
+     * backend must provide the following, with N the number of events:
+     *
+     *   Backend()                              Empty weights.
+     *   Backend(std::vector<double> const& w)  Weights w.
+     *   std::size_t size() const               N.
+     *   double sum() const                     Sum of the weights.
+     *   void update(std::size_t i, double w)   Sets the weight of event i.
+     *   std::size_t find(double probe) const   Event i with s[i] <= probe
+     *                                          < s[i+1] where s[i] is the
+     *                                          sum of the first i weights.
+     *                                          probe is in [0, sum()].
+     *
+     * The backend must be copyable. `operator==` and stream operators of the
+     * distribution require the same operators of the backend.
      */
-    template<typename T = int>
+    template<typename T = int, typename Backend = cxx::discrete_weights>
     class discrete_distribution
     {
     public:
@@ -400,23 +2252,39 @@ namespace cxx
         using result_type = T;
 
 
+        /*
+         * Type of the allocator of the sum tree. It is `detail::no_allocator`
+         * if the backend is not a sum tree in allocated memory.
+         */
+        using allocator_type = typename detail::backend_allocator<Backend>::type;
+
+
+        /*
+         * Type of the weights, namely, the backend.
+         */
+        using weights_type = Backend;
+
+
         /*
          * Class holding distribution parameter set, namely, the weights.
          */
-        class param_type : public cxx::discrete_weights
+        class param_type : public weights_type
         {
         public:
 
-            using distribution_type = cxx::discrete_distribution<T>;
+            using distribution_type = cxx::discrete_distribution<T, Backend>;
+
 
+            // Inherit constructors from the weights.
+            using weights_type::weights_type;
 
-            // Inherit constructors from discrete_weights.
-            using cxx::discrete_weights::discrete_weights;
+
+            param_type() = default;
 
 
             // Allow conversion from discrete_weights.
-            param_type(cxx::discrete_weights const& weights)
-                : discrete_weights{weights}
+            param_type(weights_type const& weights)
+                : weights_type{weights}
             {
             }
         };
@@ -451,7 +2319,32 @@ namespace cxx
          *             numbers.
          */
         discrete_distribution(std::initializer_list<double> const& weights)
-            : _weights{weights}
+            : _weights{std::vector<double>{weights}}
+        {
+        }
+
+
+        /*
+         * Creates an empty distribution using given allocator.
+         */
+        explicit
+        discrete_distribution(allocator_type const& alloc)
+            : _weights(cxx::vector_storage<allocator_type>{alloc}, 0, 0)
+        {
+        }
+
+
+        /*
+         * Creates a discrete distribution over `[0, N)` with given weights
+         * using given allocator.
+         *
+         * Params:
+         *   weights = Weight values. The weights must be non-negative finite
+         *             numbers.
+         *   alloc   = Allocator used to allocate the sum tree.
+         */
+        discrete_distribution(std::vector<double> const& weights, allocator_type const& alloc)
+            : _weights(cxx::vector_storage<allocator_type>{alloc}, weights)
         {
         }
 
@@ -469,6 +2362,17 @@ namespace cxx
         }
 
 
+        /*
+         * Returns the allocator. Available only if the backend is a sum tree
+         * in allocated memory.
+         */
+        allocator_type
+        get_allocator() const
+        {
+            return _weights.storage().get_allocator();
+        }
+
+
         /*
          * Resets the distribution state. This function does nothing.
          */
@@ -576,54 +2480,80 @@ namespace cxx
     };
 
 
-    template<typename T>
+    template<typename T, typename A>
     inline bool
     operator==(
-        cxx::discrete_distribution<T> const& d1,
-        cxx::discrete_distribution<T> const& d2
+        cxx::discrete_distribution<T, A> const& d1,
+        cxx::discrete_distribution<T, A> const& d2
     )
     {
         return d1.param() == d2.param();
     }
 
 
-    template<typename T>
+    template<typename T, typename A>
     inline bool
     operator!=(
-        cxx::discrete_distribution<T> const& d1,
-        cxx::discrete_distribution<T> const& d2
+        cxx::discrete_distribution<T, A> const& d1,
+        cxx::discrete_distribution<T, A> const& d2
     )
     {
         return !(d1 == d2);
     }
 
 
-    template<typename Char, typename Tr, typename T>
+    template<typename Char, typename Tr, typename T, typename A>
     std::basic_istream<Char, Tr>&
     operator>>(
         std::basic_istream<Char, Tr>& is,
-        cxx::discrete_distribution<T>& distr
+        cxx::discrete_distribution<T, A>& distr
     )
     {
-        using param_type = typename cxx::discrete_distribution<T>::param_type;
-        param_type param;
-        is >> param;
-        distr.param(param);
+        using param_type = typename cxx::discrete_distribution<T, A>::param_type;
+        param_type param{distr.param()};
+        if (is >> param) {
+            distr.param(param);
+        }
         return is;
     }
 
 
-    template<typename Char, typename Tr, typename T>
+    template<typename Char, typename Tr, typename T, typename A>
     std::basic_ostream<Char, Tr>&
     operator<<(
         std::basic_ostream<Char, Tr>& os,
-        cxx::discrete_distribution<T> const& distr
+        cxx::discrete_distribution<T, A> const& distr
     )
     {
         return os << distr.param();
     }
+
+
+#ifdef DISTR_HAS_MEMORY_RESOURCE
+    namespace pmr
+    {
+        /*
+         * discrete_weights using polymorphic memory resource.
+         */
+        using discrete_weights = cxx::basic_discrete_weights<
+            cxx::vector_storage<std::pmr::polymorphic_allocator<double>>
+        >;
+
+
+        /*
+         * discrete_distribution using polymorphic memory resource.
+         */
+        template<typename T = int>
+        using discrete_distribution = cxx::discrete_distribution<
+            T, cxx::pmr::discrete_weights
+        >;
+    }
+#endif
 }
 
 #undef DISTR_ASSERT
+#undef DISTR_STATS_ONLY
+#undef DISTR_HAS_TO_CHARS
+#undef DISTR_HAS_MEMORY_RESOURCE
 
 #endif
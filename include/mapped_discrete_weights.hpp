@@ -0,0 +1,335 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_MAPPED_DISCRETE_WEIGHTS_HPP
+#define INCLUDED_SNSINFU_MAPPED_DISCRETE_WEIGHTS_HPP
+
+// Memory-mapped discrete_weights for POSIX systems, providing:
+//
+// - class cxx::mapped_storage
+//   Storage policy referring to a sum tree in a memory-mapped file.
+//
+// - type cxx::mapped_discrete_weights
+//   discrete_weights operating directly on a mapped file.
+//
+// - function cxx::map_discrete_weights
+//   Maps a file written by cxx::write_binary.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "discrete_distribution.hpp"
+
+
+namespace cxx
+{
+    /*
+     * Access mode of a mapped file.
+     */
+    enum class map_mode
+    {
+        read_only,
+        read_write
+    };
+
+
+    /*
+     * Storage policy referring to the sum tree stored in a file in the
+     * format of `cxx::write_binary`. The file is mapped with `mmap`, so the
+     * operating system pages nodes in on demand: the top levels of the tree
+     * stay resident while the leaves are read only when a search reaches
+     * them. Opening a file costs O(1) regardless of its size.
+     *
+     * The storage is movable but not copyable. The mapping is released on
+     * destruction.
+     */
+    class mapped_storage
+    {
+    public:
+
+        /*
+         * Default constructor creates an empty storage.
+         */
+        mapped_storage() = default;
+
+
+        /*
+         * Maps a file.
+         *
+         * Params:
+         *   path = Path to a file written by `cxx::write_binary` in the
+         *          byte order of this machine.
+         *   mode = Whether the tree may be modified. With `read_write`,
+         *          modifications are written back to the file.
+         *
+         * Throws:
+         *   std::system_error if the file cannot be opened or mapped, and
+         *   std::runtime_error if the file is not in the expected format.
+         */
+        mapped_storage(std::string const& path, map_mode mode)
+        {
+            namespace format = detail::binary_format;
+
+            auto const writable = (mode == map_mode::read_write);
+
+            int const fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+            if (fd == -1) {
+                throw std::system_error{errno, std::generic_category(), "open " + path};
+            }
+
+            struct ::stat st;
+            if (::fstat(fd, &st) == -1) {
+                auto const err = errno;
+                ::close(fd);
+                throw std::system_error{err, std::generic_category(), "fstat " + path};
+            }
+
+            auto const file_size = std::size_t(st.st_size);
+            if (file_size < format::header_size) {
+                ::close(fd);
+                throw std::runtime_error{"truncated header: " + path};
+            }
+
+            auto const prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            auto const map = ::mmap(nullptr, file_size, prot, MAP_SHARED, fd, 0);
+            auto const map_errno = errno;
+            ::close(fd);
+
+            if (map == MAP_FAILED) {
+                throw std::system_error{map_errno, std::generic_category(), "mmap " + path};
+            }
+
+            _map = map;
+            _map_size = file_size;
+            _writable = writable;
+
+            auto const base = static_cast<char*>(map);
+
+            format::header header;
+            if (!format::decode(base, header) || header.swapped) {
+                release();
+                throw std::runtime_error{"unsupported format: " + path};
+            }
+
+            auto const tree_size = format::tree_size(header.leaves);
+            if (file_size - format::header_size < tree_size * sizeof(double)) {
+                release();
+                throw std::runtime_error{"truncated data: " + path};
+            }
+
+            // The header size keeps the tree suitably aligned because mmap
+            // returns a page-aligned address.
+            _data = reinterpret_cast<double*>(base + format::header_size);
+            _size = tree_size;
+            _events = std::size_t(header.events);
+            _leaves = std::size_t(header.leaves);
+        }
+
+
+        mapped_storage(mapped_storage const&) = delete;
+        mapped_storage& operator=(mapped_storage const&) = delete;
+
+
+        mapped_storage(mapped_storage&& other) noexcept
+        {
+            swap(other);
+        }
+
+
+        mapped_storage&
+        operator=(mapped_storage&& other) noexcept
+        {
+            mapped_storage temp{std::move(other)};
+            swap(temp);
+            return *this;
+        }
+
+
+        ~mapped_storage()
+        {
+            release();
+        }
+
+
+        void
+        swap(mapped_storage& other) noexcept
+        {
+            std::swap(_map, other._map);
+            std::swap(_map_size, other._map_size);
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_events, other._events);
+            std::swap(_leaves, other._leaves);
+            std::swap(_writable, other._writable);
+        }
+
+
+        inline double*
+        data() noexcept
+        {
+            return _data;
+        }
+
+
+        inline double const*
+        data() const noexcept
+        {
+            return _data;
+        }
+
+
+        inline std::size_t
+        size() const noexcept
+        {
+            return _size;
+        }
+
+
+        /*
+         * Returns the number of events recorded in the file header.
+         */
+        inline std::size_t
+        events() const noexcept
+        {
+            return _events;
+        }
+
+
+        /*
+         * Returns the number of leaves recorded in the file header.
+         */
+        inline std::size_t
+        leaves() const noexcept
+        {
+            return _leaves;
+        }
+
+
+        /*
+         * Returns true if the mapping allows modification.
+         */
+        inline bool
+        writable() const noexcept
+        {
+            return _writable;
+        }
+
+
+        /*
+         * Flushes modifications to the file.
+         *
+         * Params:
+         *   wait = If true, block until the data is written. Otherwise just
+         *          schedule the write.
+         *
+         * Throws:
+         *   std::system_error if msync fails.
+         */
+        void
+        sync(bool wait = true)
+        {
+            if (_map == nullptr || !_writable) {
+                return;
+            }
+            if (::msync(_map, _map_size, wait ? MS_SYNC : MS_ASYNC) == -1) {
+                throw std::system_error{errno, std::generic_category(), "msync"};
+            }
+        }
+
+
+    private:
+
+        void
+        release() noexcept
+        {
+            if (_map != nullptr) {
+                ::munmap(_map, _map_size);
+            }
+            _map = nullptr;
+            _map_size = 0;
+            _data = nullptr;
+            _size = 0;
+        }
+
+
+    private:
+        void* _map = nullptr;
+        std::size_t _map_size = 0;
+        double* _data = nullptr;
+        std::size_t _size = 0;
+        std::size_t _events = 0;
+        std::size_t _leaves = 0;
+        bool _writable = false;
+    };
+
+
+    /*
+     * discrete_weights operating directly on a memory-mapped file.
+     *
+     * `update` must not be called on a read-only mapping. Call
+     * `storage().sync()` to flush updates made on a read-write mapping.
+     */
+    using mapped_discrete_weights = cxx::basic_discrete_weights<cxx::mapped_storage>;
+
+
+    /*
+     * Maps a file written by `cxx::write_binary`.
+     *
+     * Params:
+     *   path = Path to the file.
+     *   mode = Access mode.
+     *
+     * Returns:
+     *   Weights referring to the mapped tree.
+     *
+     * Throws:
+     *   See `cxx::mapped_storage`.
+     *
+     * Time complexity:
+     *   O(1). No part of the tree is read until it is accessed.
+     */
+    inline mapped_discrete_weights
+    map_discrete_weights(std::string const& path, map_mode mode = map_mode::read_only)
+    {
+        cxx::mapped_storage storage{path, mode};
+        auto const events = storage.events();
+        auto const leaves = storage.leaves();
+        return mapped_discrete_weights{std::move(storage), events, leaves};
+    }
+}
+
+#endif
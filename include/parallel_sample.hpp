@@ -0,0 +1,115 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_PARALLEL_SAMPLE_HPP
+#define INCLUDED_SNSINFU_PARALLEL_SAMPLE_HPP
+
+// Reproducible bulk sampling, providing:
+//
+// - function cxx::sample_parallel
+//   Draws many samples using counter-based random numbers so that the
+//   results do not depend on the number of threads.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "parallel_update.hpp"
+#include "philox.hpp"
+
+
+namespace cxx
+{
+    /*
+     * Draws n samples from a distribution. Sample j is drawn with a
+     * `cxx::philox4x32` engine using given key and the stream number
+     * `counter_base + j`, so the samples are the same regardless of the
+     * executor and the number of threads.
+     *
+     * Params:
+     *   distr        = Distribution callable as `distr(engine)` on a const
+     *                  reference, such as `cxx::discrete_distribution`.
+     *   key          = Key of the random number engine.
+     *   counter_base = Stream number for the first sample. Use disjoint
+     *                  ranges of stream numbers for independent batches.
+     *   n            = Number of samples.
+     *   out          = Random access iterator to the first output.
+     *   executor     = Executor such as `cxx::thread_executor`.
+     *
+     * Time complexity:
+     *   O(n) samples.
+     */
+    template<typename Distribution, typename RandomIt, typename Executor>
+    void
+    sample_parallel(
+        Distribution const& distr,
+        std::uint64_t key,
+        std::uint64_t counter_base,
+        std::size_t n,
+        RandomIt out,
+        Executor&& executor
+    )
+    {
+        using difference_type = typename std::iterator_traits<RandomIt>::difference_type;
+
+        detail::for_chunks(executor, n, [&](std::size_t begin, std::size_t end, std::size_t) {
+            cxx::philox4x32 engine;
+
+            for (auto j = begin; j < end; j++) {
+                engine.seed(key, counter_base + j);
+                out[difference_type(j)] = distr(engine);
+            }
+        });
+    }
+
+
+    /*
+     * Draws n samples on the calling thread. The result is identical to
+     * `sample_parallel` with any executor.
+     */
+    template<typename Distribution, typename RandomIt>
+    void
+    sample_parallel(
+        Distribution const& distr,
+        std::uint64_t key,
+        std::uint64_t counter_base,
+        std::size_t n,
+        RandomIt out
+    )
+    {
+        using difference_type = typename std::iterator_traits<RandomIt>::difference_type;
+
+        cxx::philox4x32 engine;
+
+        for (std::size_t j = 0; j < n; j++) {
+            engine.seed(key, counter_base + j);
+            out[difference_type(j)] = distr(engine);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,343 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_PARALLEL_UPDATE_HPP
+#define INCLUDED_SNSINFU_PARALLEL_UPDATE_HPP
+
+// Parallel batch update of discrete weights, providing:
+//
+// - function cxx::parallel_update
+//   Updates many weights at once using multiple threads.
+//
+// - function cxx::parallel_refresh
+//   Recomputes the whole sum tree using multiple threads.
+//
+// - class cxx::thread_executor
+//   Executor running tasks on a pool of threads spawned per call.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    /*
+     * Executor that runs tasks on threads spawned for each call. The calling
+     * thread also runs tasks.
+     *
+     * An executor is any object callable as `executor(tasks, task)` that
+     * calls `task(t)` once for each t in [0, tasks), possibly concurrently,
+     * and returns after all calls finish.
+     */
+    class thread_executor
+    {
+    public:
+
+        /*
+         * Creates an executor.
+         *
+         * Params:
+         *   threads = Number of threads including the calling thread. Zero
+         *             means the number of hardware threads.
+         */
+        explicit
+        thread_executor(unsigned threads = 0)
+            : _threads{threads}
+        {
+            if (_threads == 0) {
+                _threads = std::thread::hardware_concurrency();
+            }
+            if (_threads == 0) {
+                _threads = 1;
+            }
+        }
+
+
+        /*
+         * Returns the number of threads.
+         */
+        inline unsigned
+        threads() const noexcept
+        {
+            return _threads;
+        }
+
+
+        /*
+         * Calls `task(t)` for each t in [0, tasks) and waits for all calls to
+         * finish. `task` must not throw.
+         *
+         * Throws:
+         *   std::system_error if a thread cannot be created, after the
+         *   threads already started finish their current tasks. Remaining
+         *   tasks are not run.
+         */
+        template<typename Task>
+        void
+        operator()(std::size_t tasks, Task task) const
+        {
+            std::atomic<std::size_t> next{0};
+
+            auto worker = [&] {
+                for (;;) {
+                    auto const t = next.fetch_add(1, std::memory_order_relaxed);
+                    if (t >= tasks) {
+                        break;
+                    }
+                    task(t);
+                }
+            };
+
+            std::vector<std::thread> helpers;
+            auto const helper_count = std::min<std::size_t>(_threads, tasks);
+
+            // Destroying a joinable thread terminates the program, so the
+            // started helpers are stopped and joined before an exception
+            // from thread creation propagates.
+            auto const join_all = [&] {
+                for (auto& helper : helpers) {
+                    helper.join();
+                }
+            };
+
+            try {
+                helpers.reserve(helper_count);
+
+                for (std::size_t i = 1; i < helper_count; i++) {
+                    helpers.emplace_back(worker);
+                }
+            } catch (...) {
+                next.store(tasks, std::memory_order_relaxed);
+                join_all();
+                throw;
+            }
+
+            worker();
+            join_all();
+        }
+
+
+    private:
+        unsigned _threads;
+    };
+
+
+    namespace detail
+    {
+        // Number of items processed by a task in parallel algorithms. Fewer
+        // items are processed on the calling thread.
+        constexpr std::size_t parallel_grain = 4096;
+
+
+        // Runs `task(begin, end, t)` over chunks of [0, count) using the
+        // executor, or directly if the range is small.
+        template<typename Executor, typename Task>
+        void
+        for_chunks(Executor& executor, std::size_t count, Task task)
+        {
+            auto const grain = parallel_grain;
+            auto const tasks = (count + grain - 1) / grain;
+
+            if (tasks <= 1) {
+                task(std::size_t(0), count, std::size_t(0));
+                return;
+            }
+
+            executor(tasks, [&](std::size_t t) {
+                auto const begin = t * grain;
+                auto const end = std::min(begin + grain, count);
+                task(begin, end, t);
+            });
+        }
+    }
+
+
+    /*
+     * Updates weights of many events using an executor. The result is
+     * identical to calling `weights.update(indices[k], values[k])` for each
+     * k in order: when an index appears more than once, the last value wins.
+     *
+     * Leaves are written in parallel. Then the dirty ancestors are recomputed
+     * one level at a time from the bottom. Each level depends only on the
+     * level below, and each dirty node is computed by exactly one task, so
+     * no atomic operation or lock is involved.
+     *
+     * Params:
+     *   weights  = Weights to update.
+     *   indices  = Indices of events to update. Processed faster if sorted.
+     *   values   = New weights. Must have the same size as `indices`.
+     *   executor = Executor such as `cxx::thread_executor`.
+     *
+     * Time complexity:
+     *   O(K log N) work where K is the number of updated events, plus
+     *   O(K log K) if `indices` is not sorted.
+     */
+    template<typename Storage, typename Executor>
+    void
+    parallel_update(
+        cxx::basic_discrete_weights<Storage>& weights,
+        std::vector<std::size_t> const& indices,
+        std::vector<double> const& values,
+        Executor&& executor
+    )
+    {
+        DISTR_ASSERT(indices.size() == values.size());
+
+        if (indices.empty()) {
+            return;
+        }
+
+        auto const tree = weights.storage().data();
+        auto const leaf_base = weights.leaves() - 1;
+        auto const grain = detail::parallel_grain;
+
+        // Dirty leaves in ascending order with the position of the value to
+        // write. Among equal indices the last position wins.
+        std::vector<std::size_t> dirty;
+        std::vector<std::size_t> sources;
+        dirty.reserve(indices.size());
+        sources.reserve(indices.size());
+
+        if (std::is_sorted(indices.begin(), indices.end())) {
+            for (std::size_t k = 0; k < indices.size(); k++) {
+                if (k + 1 == indices.size() || indices[k + 1] != indices[k]) {
+                    dirty.push_back(leaf_base + indices[k]);
+                    sources.push_back(k);
+                }
+            }
+        } else {
+            std::vector<std::pair<std::size_t, std::size_t>> pairs(indices.size());
+            for (std::size_t k = 0; k < indices.size(); k++) {
+                pairs[k] = {indices[k], k};
+            }
+            std::sort(pairs.begin(), pairs.end());
+
+            for (std::size_t k = 0; k < pairs.size(); k++) {
+                if (k + 1 == pairs.size() || pairs[k + 1].first != pairs[k].first) {
+                    dirty.push_back(leaf_base + pairs[k].first);
+                    sources.push_back(pairs[k].second);
+                }
+            }
+        }
+
+        detail::for_chunks(executor, dirty.size(), [&](std::size_t begin, std::size_t end, std::size_t) {
+            for (auto k = begin; k < end; k++) {
+                DISTR_ASSERT(dirty[k] - leaf_base < weights.size());
+                DISTR_ASSERT(values[sources[k]] >= 0);
+                tree[dirty[k]] = values[sources[k]];
+            }
+        });
+
+        // Sorted dirty nodes have sorted parents, so duplicates are adjacent.
+        // A chunk skips a parent already taken by the end of the previous
+        // chunk. Chunk t writes its parents to the front of its own range of
+        // `parents`, and the ranges are compacted afterwards.
+        std::vector<std::size_t> parents(dirty.size());
+        std::vector<std::size_t> counts;
+
+        while (dirty.front() != 0) {
+            counts.assign((dirty.size() + grain - 1) / grain, 0);
+
+            detail::for_chunks(executor, dirty.size(), [&](std::size_t begin, std::size_t end, std::size_t t) {
+                auto prev = begin == 0 ? std::size_t(-1) : (dirty[begin - 1] - 1) / 2;
+                auto out = begin;
+
+                for (auto k = begin; k < end; k++) {
+                    auto const parent = (dirty[k] - 1) / 2;
+                    if (parent == prev) {
+                        continue;
+                    }
+                    tree[parent] = tree[2 * parent + 1] + tree[2 * parent + 2];
+                    parents[out++] = parent;
+                    prev = parent;
+                }
+
+                counts[t] = out - begin;
+            });
+
+            std::size_t size = 0;
+            for (std::size_t t = 0; t < counts.size(); t++) {
+                auto const begin = parents.begin() + std::ptrdiff_t(t * grain);
+                std::copy(begin, begin + std::ptrdiff_t(counts[t]), parents.begin() + std::ptrdiff_t(size));
+                size += counts[t];
+            }
+            parents.resize(size);
+            dirty.swap(parents);
+            parents.resize(dirty.size());
+        }
+    }
+
+
+    /*
+     * Recomputes the sums of the tree from the weights using an executor.
+     * The result is identical to `weights.refresh()`.
+     *
+     * Each level of the tree is split into chunks computed in parallel,
+     * from the bottom level to the root.
+     *
+     * Params:
+     *   weights  = Weights to refresh.
+     *   executor = Executor such as `cxx::thread_executor`.
+     *
+     * Time complexity:
+     *   O(N) work where N is the number of events.
+     */
+    template<typename Storage, typename Executor>
+    void
+    parallel_refresh(cxx::basic_discrete_weights<Storage>& weights, Executor&& executor)
+    {
+        auto const tree = weights.storage().data();
+
+        for (auto layer_size = weights.leaves() / 2; layer_size > 0; layer_size /= 2) {
+            auto const start = layer_size - 1;
+
+            detail::for_chunks(executor, layer_size, [&](std::size_t begin, std::size_t end, std::size_t) {
+                for (auto node = start + begin; node < start + end; node++) {
+                    tree[node] = tree[2 * node + 1] + tree[2 * node + 2];
+                }
+            });
+        }
+    }
+}
+
+#undef DISTR_ASSERT
+
+#endif
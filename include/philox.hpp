@@ -0,0 +1,259 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_PHILOX_HPP
+#define INCLUDED_SNSINFU_PHILOX_HPP
+
+// Counter-based random number engine, providing:
+//
+// - class cxx::philox4x32
+//   Philox4x32-10 engine of Salmon et al. (2011) satisfying the
+//   UniformRandomBitGenerator requirements.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <cstdint>
+#include <limits>
+
+
+namespace cxx
+{
+    /*
+     * Philox4x32-10 random number engine.
+     *
+     * Output is a pure function of a 64-bit key, a 64-bit stream number and
+     * the position in the stream, so any position of any stream can be
+     * reached in O(1) without generating the preceding numbers. Give each
+     * independent task its own stream to get results that do not depend on
+     * how tasks are scheduled.
+     *
+     * The 128-bit counter consists of the stream number in the upper 64 bits
+     * and the block index in the lower 64 bits. Each block yields four
+     * 32-bit outputs.
+     */
+    class philox4x32
+    {
+    public:
+
+        /*
+         * Type of generated integer.
+         */
+        using result_type = std::uint32_t;
+
+
+        static constexpr result_type
+        min() noexcept
+        {
+            return 0;
+        }
+
+
+        static constexpr result_type
+        max() noexcept
+        {
+            return std::numeric_limits<result_type>::max();
+        }
+
+
+        /*
+         * Creates an engine at the start of given stream.
+         *
+         * Params:
+         *   key    = Key, like the seed of a conventional engine.
+         *   stream = Stream number.
+         */
+        explicit
+        philox4x32(std::uint64_t key = 0, std::uint64_t stream = 0) noexcept
+        {
+            seed(key, stream);
+        }
+
+
+        /*
+         * Moves the engine to the start of given stream.
+         */
+        void
+        seed(std::uint64_t key, std::uint64_t stream = 0) noexcept
+        {
+            _key = key;
+            _stream = stream;
+            _block = 0;
+            _position = 4;
+        }
+
+
+        /*
+         * Returns the key.
+         */
+        inline std::uint64_t
+        key() const noexcept
+        {
+            return _key;
+        }
+
+
+        /*
+         * Returns the stream number.
+         */
+        inline std::uint64_t
+        stream() const noexcept
+        {
+            return _stream;
+        }
+
+
+        /*
+         * Generates a random integer.
+         */
+        result_type
+        operator()() noexcept
+        {
+            if (_position == 4) {
+                generate_block();
+                _block++;
+                _position = 0;
+            }
+            return _output[_position++];
+        }
+
+
+        /*
+         * Skips given number of outputs.
+         *
+         * Time complexity:
+         *   O(1).
+         */
+        void
+        discard(unsigned long long count) noexcept
+        {
+            auto const buffered = std::uint64_t(4 - _position);
+            if (count <= buffered) {
+                _position += unsigned(count);
+                return;
+            }
+            count -= buffered;
+
+            _block += (count - 1) / 4;
+            generate_block();
+            _block++;
+            _position = unsigned((count - 1) % 4 + 1);
+        }
+
+
+        /*
+         * Computes the Philox4x32-10 block function.
+         *
+         * Params:
+         *   counter = Four 32-bit counter words. Overwritten with the output.
+         *   key     = Two 32-bit key words.
+         */
+        static void
+        block(std::uint32_t counter[4], std::uint32_t const key[2]) noexcept
+        {
+            std::uint32_t const multiplier0 = 0xD2511F53;
+            std::uint32_t const multiplier1 = 0xCD9E8D57;
+            std::uint32_t const weyl0 = 0x9E3779B9;
+            std::uint32_t const weyl1 = 0xBB67AE85;
+
+            std::uint32_t k0 = key[0];
+            std::uint32_t k1 = key[1];
+
+            for (int round = 0; round < 10; round++) {
+                auto const product0 = std::uint64_t(multiplier0) * counter[0];
+                auto const product1 = std::uint64_t(multiplier1) * counter[2];
+
+                auto const hi0 = std::uint32_t(product0 >> 32);
+                auto const lo0 = std::uint32_t(product0);
+                auto const hi1 = std::uint32_t(product1 >> 32);
+                auto const lo1 = std::uint32_t(product1);
+
+                counter[0] = hi1 ^ counter[1] ^ k0;
+                counter[1] = lo1;
+                counter[2] = hi0 ^ counter[3] ^ k1;
+                counter[3] = lo0;
+
+                k0 += weyl0;
+                k1 += weyl1;
+            }
+        }
+
+
+        friend bool
+        operator==(philox4x32 const& e1, philox4x32 const& e2) noexcept
+        {
+            // Engines at the end of a block and at the start of the next
+            // block are in the same state.
+            return e1._key == e2._key
+                && e1._stream == e2._stream
+                && e1.offset() == e2.offset();
+        }
+
+
+        friend bool
+        operator!=(philox4x32 const& e1, philox4x32 const& e2) noexcept
+        {
+            return !(e1 == e2);
+        }
+
+
+    private:
+
+        // Returns the number of outputs consumed in the stream.
+        std::uint64_t
+        offset() const noexcept
+        {
+            return _block * 4 - (4 - _position);
+        }
+
+
+        void
+        generate_block() noexcept
+        {
+            _output[0] = std::uint32_t(_block);
+            _output[1] = std::uint32_t(_block >> 32);
+            _output[2] = std::uint32_t(_stream);
+            _output[3] = std::uint32_t(_stream >> 32);
+
+            std::uint32_t const key[2] = {
+                std::uint32_t(_key),
+                std::uint32_t(_key >> 32)
+            };
+            block(_output, key);
+        }
+
+
+    private:
+        // _block is the index of the next block to generate. _position is
+        // the number of outputs consumed from the last generated block, or
+        // 4 if none is buffered.
+        std::uint64_t _key;
+        std::uint64_t _stream;
+        std::uint64_t _block;
+        unsigned _position;
+        std::uint32_t _output[4] = {};
+    };
+}
+
+#endif
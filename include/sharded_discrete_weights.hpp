@@ -0,0 +1,355 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_SHARDED_DISCRETE_WEIGHTS_HPP
+#define INCLUDED_SNSINFU_SHARDED_DISCRETE_WEIGHTS_HPP
+
+// Discrete weights split into shards owned by different threads, providing:
+//
+// - class cxx::sharded_discrete_weights
+//   Weights partitioned into contiguous shards, each updated by its own
+//   thread without contention, and sampled by any thread.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent_discrete_distribution.hpp"
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    /*
+     * Discrete weights partitioned into S contiguous shards.
+     *
+     * Each shard is a sum tree with a single writer, and the shard sums are
+     * kept in a top level of S atomic slots. An update touches only its
+     * shard and the shard's slot, so threads that update different shards do
+     * not contend. Sampling draws one probe over the total, selects a shard
+     * by the slots and then an event within the shard. Any thread may
+     * sample at any time.
+     *
+     * Updates to the same shard must not run concurrently. Typically thread
+     * s owns shard s. A sample concurrent with updates may select a shard
+     * with its previous sum, but it always returns an index in range and
+     * never observes a shard in the middle of an update.
+     *
+     * The object is neither copyable nor movable.
+     */
+    class sharded_discrete_weights
+    {
+        using shard_type = cxx::concurrent_discrete_distribution<std::size_t>;
+
+        // Slot of the top level. Aligned to a cache line so that writers of
+        // different shards do not share a line. Operator new does not honor
+        // the alignment before C++17, so slots are placed in a buffer
+        // aligned by hand; see `make_slots`.
+        struct alignas(64) slot
+        {
+            std::atomic<double> sum {0.0};
+        };
+
+        static_assert(
+            std::is_trivially_destructible<slot>::value,
+            "slots are released without running destructors"
+        );
+
+    public:
+
+        /*
+         * Constructs sharded weights.
+         *
+         * Params:
+         *   weights = Non-negative weights of the events.
+         *   shards  = Number of shards. Events are split into contiguous
+         *             ranges of nearly equal sizes. Must be positive.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        sharded_discrete_weights(std::vector<double> const& weights, std::size_t shards)
+            : _events{weights.size()}
+            , _slots{make_slots(_slot_buffer, shards)}
+        {
+            DISTR_ASSERT(shards > 0);
+
+            _offsets.reserve(shards + 1);
+            _shards.reserve(shards);
+
+            for (std::size_t s = 0; s <= shards; s++) {
+                _offsets.push_back(_events * s / shards);
+            }
+
+            for (std::size_t s = 0; s < shards; s++) {
+                auto const begin = weights.begin() + std::ptrdiff_t(_offsets[s]);
+                auto const end = weights.begin() + std::ptrdiff_t(_offsets[s + 1]);
+
+                _shards.emplace_back(new shard_type{std::vector<double>(begin, end)});
+                _slots[s].sum.store(_shards[s]->sum(), std::memory_order_relaxed);
+            }
+        }
+
+
+        sharded_discrete_weights(sharded_discrete_weights const&) = delete;
+        sharded_discrete_weights& operator=(sharded_discrete_weights const&) = delete;
+
+
+        /*
+         * Returns the number of events.
+         */
+        inline std::size_t
+        size() const noexcept
+        {
+            return _events;
+        }
+
+
+        /*
+         * Returns the number of shards.
+         */
+        inline std::size_t
+        shards() const noexcept
+        {
+            return _shards.size();
+        }
+
+
+        /*
+         * Returns the index of the first event in the s-th shard. The index
+         * one past the last event is `shard_begin(s + 1)`.
+         */
+        inline std::size_t
+        shard_begin(std::size_t s) const noexcept
+        {
+            DISTR_ASSERT(s <= shards());
+            return _offsets[s];
+        }
+
+
+        /*
+         * Returns the index of the shard containing the i-th event.
+         *
+         * Time complexity:
+         *   O(log S).
+         */
+        std::size_t
+        shard_of(std::size_t i) const noexcept
+        {
+            DISTR_ASSERT(i < _events);
+
+            std::size_t lo = 0;
+            std::size_t hi = shards();
+
+            while (hi - lo > 1) {
+                auto const mid = lo + (hi - lo) / 2;
+                if (i < _offsets[mid]) {
+                    hi = mid;
+                } else {
+                    lo = mid;
+                }
+            }
+
+            return lo;
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         *
+         * Time complexity:
+         *   O(S).
+         */
+        double
+        sum() const noexcept
+        {
+            double total = 0;
+            for (std::size_t s = 0; s < shards(); s++) {
+                total += shard_sum(s);
+            }
+            return total;
+        }
+
+
+        /*
+         * Returns the sum of the weights in the s-th shard.
+         */
+        inline double
+        shard_sum(std::size_t s) const noexcept
+        {
+            return _slots[s].sum.load(std::memory_order_relaxed);
+        }
+
+
+        /*
+         * Returns the weight of the i-th event.
+         */
+        double
+        operator[](std::size_t i) const noexcept
+        {
+            auto const s = shard_of(i);
+            return (*_shards[s])[i - _offsets[s]];
+        }
+
+
+        /*
+         * Updates the weight of the i-th event. Threads may call this
+         * function concurrently as long as they update different shards.
+         *
+         * Time complexity:
+         *   O(log(N/S) + log S).
+         */
+        void
+        update(std::size_t i, double weight) noexcept
+        {
+            update_shard(shard_of(i), i, weight);
+        }
+
+
+        /*
+         * Updates the weight of the i-th event, which must be in the s-th
+         * shard. Same as `update(i, weight)` but skips the shard lookup.
+         *
+         * Time complexity:
+         *   O(log(N/S)).
+         */
+        void
+        update_shard(std::size_t s, std::size_t i, double weight) noexcept
+        {
+            DISTR_ASSERT(s < shards());
+            DISTR_ASSERT(i >= _offsets[s] && i < _offsets[s + 1]);
+
+            auto& shard = *_shards[s];
+            shard.update(i - _offsets[s], weight);
+            _slots[s].sum.store(shard.sum(), std::memory_order_relaxed);
+        }
+
+
+        /*
+         * Finds the event whose cumulative weight interval covers given probe
+         * value. See `discrete_weights::find`.
+         *
+         * Time complexity:
+         *   O(S + log(N/S)).
+         */
+        std::size_t
+        find(double probe) const noexcept
+        {
+            DISTR_ASSERT(_events > 0);
+
+            auto const s = find_shard(probe);
+            return _offsets[s] + _shards[s]->find(probe);
+        }
+
+
+        /*
+         * Samples an event with probability proportional to its weight.
+         * Thread-safe. Uses a single uniform random number.
+         *
+         * Time complexity:
+         *   O(S + log(N/S)).
+         */
+        template<typename RNG>
+        std::size_t
+        operator()(RNG& random) const
+        {
+            DISTR_ASSERT(_events > 0);
+
+            std::uniform_real_distribution<double> uniform{0.0, 1.0};
+            return find(uniform(random) * sum());
+        }
+
+
+    private:
+
+        // Selects the shard covering the probe and subtracts the sums of
+        // preceding shards from the probe. Empty shards are never selected.
+        std::size_t
+        find_shard(double& probe) const noexcept
+        {
+            std::size_t last = 0;
+
+            for (std::size_t s = 0; s < shards(); s++) {
+                if (_offsets[s] == _offsets[s + 1]) {
+                    continue;
+                }
+                last = s;
+
+                auto const shard_sum = this->shard_sum(s);
+                if (probe < shard_sum) {
+                    return s;
+                }
+                probe -= shard_sum;
+            }
+
+            return last;
+        }
+
+
+        // Allocates `count` slots aligned to a cache line in `buffer`.
+        static slot*
+        make_slots(std::unique_ptr<char[]>& buffer, std::size_t count)
+        {
+            auto const size = count * sizeof(slot);
+            auto space = size + alignof(slot);
+            buffer.reset(new char[space]);
+
+            void* ptr = buffer.get();
+            std::align(alignof(slot), size, ptr, space);
+
+            auto const slots = static_cast<slot*>(ptr);
+            for (std::size_t s = 0; s < count; s++) {
+                new(slots + s) slot;
+            }
+            return slots;
+        }
+
+
+    private:
+        std::size_t _events;
+        std::vector<std::size_t> _offsets;
+        std::vector<std::unique_ptr<shard_type>> _shards;
+        std::unique_ptr<char[]> _slot_buffer;
+        slot* _slots;
+    };
+}
+
+#undef DISTR_ASSERT
+
+#endif
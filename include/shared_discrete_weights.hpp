@@ -0,0 +1,616 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_SHARED_DISCRETE_WEIGHTS_HPP
+#define INCLUDED_SNSINFU_SHARED_DISCRETE_WEIGHTS_HPP
+
+// Discrete weights in POSIX shared memory for multi-process sampling,
+// providing:
+//
+// - class cxx::shared_discrete_weights
+//   Sum tree in a shared memory segment with a single writer process and
+//   any number of reader processes.
+//
+// Programs using this header may need to be linked with `-lrt` on older
+// systems.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "concurrent_discrete_distribution.hpp"
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    namespace detail
+    {
+        namespace shared_format
+        {
+            // Segment layout:
+            //
+            //   offset  size  field
+            //   0       8     magic "CXXDSHM1", stored last with release
+            //   8       8     number of events
+            //   16      8     number of leaves
+            //   64      8     sequence number
+            //   128     8*M   sum tree where M = 2 * leaves - 1
+            //
+            constexpr std::size_t magic_size = 8;
+            constexpr std::size_t sequence_offset = 64;
+            constexpr std::size_t tree_offset = 128;
+
+
+            inline char const*
+            magic() noexcept
+            {
+                return "CXXDSHM1";
+            }
+
+
+            // Returns the magic as the 64-bit word stored atomically at
+            // offset 0. Its bytes are the same as the magic string.
+            inline std::uint64_t
+            magic_word() noexcept
+            {
+                std::uint64_t word;
+                std::memcpy(&word, magic(), sizeof word);
+                return word;
+            }
+
+
+            inline std::size_t
+            segment_size(std::size_t leaves) noexcept
+            {
+                return tree_offset + (2 * leaves - 1) * sizeof(double);
+            }
+        }
+    }
+
+
+    /*
+     * Discrete weights stored in a POSIX shared memory segment.
+     *
+     * One process creates the segment with `create` and becomes the writer.
+     * Other processes attach to it with `open` and become readers. Readers
+     * sample and query the weights concurrently with updates by the writer,
+     * and every query observes the tree as of a single version: a reader
+     * never sees a root path in the middle of an update. Readers map the
+     * segment read-only and cannot update it.
+     *
+     * A writer that dies in the middle of an update leaves the segment
+     * locked. Readers detect it when an update seems to take longer than
+     * the write timeout given to `open`, and throw std::runtime_error
+     * instead of waiting forever.
+     *
+     * The object is movable but not copyable. The mapping is released on
+     * destruction; the segment itself persists until `unlink` is called.
+     */
+    class shared_discrete_weights
+    {
+        static_assert(
+            sizeof(std::atomic<double>) == sizeof(double) &&
+            sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t),
+            "atomics must have the same layout as plain values"
+        );
+
+    public:
+
+        /*
+         * Default constructor creates an empty object not attached to any
+         * segment.
+         */
+        shared_discrete_weights() = default;
+
+
+        /*
+         * Creates a shared memory segment holding given weights. The calling
+         * process becomes the writer.
+         *
+         * Params:
+         *   name    = Name of the segment in the form "/name".
+         *   weights = Initial weights. Copied without rebuilding the tree.
+         *
+         * Throws:
+         *   std::system_error if the segment cannot be created, e.g., it
+         *   already exists, and std::runtime_error if lock-free atomics are
+         *   not available.
+         */
+        template<typename Storage>
+        static shared_discrete_weights
+        create(std::string const& name, cxx::basic_discrete_weights<Storage> const& weights)
+        {
+            namespace format = detail::shared_format;
+
+            check_lock_free();
+
+            auto const leaves = weights.leaves() == 0 ? 1 : weights.leaves();
+            auto const size = format::segment_size(leaves);
+
+            int const fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd == -1) {
+                throw std::system_error{errno, std::generic_category(), "shm_open " + name};
+            }
+
+            if (::ftruncate(fd, off_t(size)) == -1) {
+                auto const err = errno;
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                throw std::system_error{err, std::generic_category(), "ftruncate " + name};
+            }
+
+            shared_discrete_weights shared;
+            try {
+                shared.map(fd, size, true);
+            } catch (...) {
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                throw;
+            }
+            ::close(fd);
+
+            // The segment is zero-filled, so the magic reads as absent
+            // until it is published after everything else below.
+            auto const base = static_cast<char*>(shared._map);
+            auto const magic = new(base) std::atomic<std::uint64_t>{0};
+            std::uint64_t const events64 = weights.size();
+            std::uint64_t const leaves64 = leaves;
+            std::memcpy(base + 8, &events64, sizeof events64);
+            std::memcpy(base + 16, &leaves64, sizeof leaves64);
+
+            auto& tree = shared._tree;
+            tree.sequence = new(base + format::sequence_offset) std::atomic<std::uint64_t>{0};
+            tree.nodes = reinterpret_cast<std::atomic<double>*>(base + format::tree_offset);
+            tree.leaves = leaves;
+            tree.events = weights.size();
+
+            auto const source = weights.storage().data();
+            for (std::size_t node = 0; node < 2 * leaves - 1; node++) {
+                new(tree.nodes + node) std::atomic<double>{
+                    weights.leaves() == 0 ? 0.0 : source[node]
+                };
+            }
+
+            // Publish the segment. A reader that acquires the magic sees the
+            // header and the tree initialized.
+            magic->store(format::magic_word(), std::memory_order_release);
+
+            shared._writable = true;
+
+            return shared;
+        }
+
+
+        /*
+         * Attaches to an existing segment as a reader.
+         *
+         * Params:
+         *   name          = Name of the segment passed to `create`.
+         *   write_timeout = Longest time an update by the writer may take.
+         *                   A reader waiting longer for an update to end
+         *                   assumes that the writer died.
+         *
+         * Throws:
+         *   std::system_error if the segment cannot be opened, and
+         *   std::runtime_error if it is not a valid segment or its creation
+         *   has not completed.
+         */
+        static shared_discrete_weights
+        open(
+            std::string const& name,
+            std::chrono::nanoseconds write_timeout = std::chrono::seconds{1}
+        )
+        {
+            namespace format = detail::shared_format;
+
+            // Lock-free atomics of the size of a word are loaded with plain
+            // loads, which work on the read-only mapping below.
+            check_lock_free();
+
+            int const fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd == -1) {
+                throw std::system_error{errno, std::generic_category(), "shm_open " + name};
+            }
+
+            struct ::stat st;
+            if (::fstat(fd, &st) == -1) {
+                auto const err = errno;
+                ::close(fd);
+                throw std::system_error{err, std::generic_category(), "fstat " + name};
+            }
+
+            auto const size = std::size_t(st.st_size);
+            if (size < format::tree_offset) {
+                ::close(fd);
+                throw std::runtime_error{"invalid shared weights: " + name};
+            }
+
+            shared_discrete_weights shared;
+            try {
+                shared.map(fd, size, false);
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+            shared._write_timeout = write_timeout;
+
+            // Acquire the magic before reading anything else, so that a
+            // segment still being created is rejected rather than read
+            // half-initialized.
+            auto const base = static_cast<char*>(shared._map);
+            auto const magic = reinterpret_cast<std::atomic<std::uint64_t>*>(base);
+            auto const published = magic->load(std::memory_order_acquire) == format::magic_word();
+
+            std::uint64_t events64;
+            std::uint64_t leaves64;
+            std::memcpy(&events64, base + 8, sizeof events64);
+            std::memcpy(&leaves64, base + 16, sizeof leaves64);
+
+            auto const valid =
+                published &&
+                leaves64 != 0 &&
+                (leaves64 & (leaves64 - 1)) == 0 &&
+                leaves64 >= events64 &&
+                leaves64 <= size / sizeof(double) &&
+                format::segment_size(std::size_t(leaves64)) <= size;
+
+            if (!valid) {
+                throw std::runtime_error{"invalid shared weights: " + name};
+            }
+
+            auto& tree = shared._tree;
+            tree.sequence = reinterpret_cast<std::atomic<std::uint64_t>*>(
+                base + format::sequence_offset
+            );
+            tree.nodes = reinterpret_cast<std::atomic<double>*>(base + format::tree_offset);
+            tree.leaves = std::size_t(leaves64);
+            tree.events = std::size_t(events64);
+
+            return shared;
+        }
+
+
+        /*
+         * Removes the name of a segment. Processes attached to the segment
+         * can keep using it.
+         *
+         * Returns:
+         *   True on success, false if the segment does not exist.
+         */
+        static bool
+        unlink(std::string const& name) noexcept
+        {
+            return ::shm_unlink(name.c_str()) == 0;
+        }
+
+
+        shared_discrete_weights(shared_discrete_weights const&) = delete;
+        shared_discrete_weights& operator=(shared_discrete_weights const&) = delete;
+
+
+        shared_discrete_weights(shared_discrete_weights&& other) noexcept
+        {
+            swap(other);
+        }
+
+
+        shared_discrete_weights&
+        operator=(shared_discrete_weights&& other) noexcept
+        {
+            shared_discrete_weights temp{std::move(other)};
+            swap(temp);
+            return *this;
+        }
+
+
+        ~shared_discrete_weights()
+        {
+            if (_map != nullptr) {
+                ::munmap(_map, _map_size);
+            }
+        }
+
+
+        void
+        swap(shared_discrete_weights& other) noexcept
+        {
+            std::swap(_map, other._map);
+            std::swap(_map_size, other._map_size);
+            std::swap(_tree, other._tree);
+            std::swap(_writable, other._writable);
+            std::swap(_write_timeout, other._write_timeout);
+        }
+
+
+        /*
+         * Returns true if this object is the writer.
+         */
+        inline bool
+        writable() const noexcept
+        {
+            return _writable;
+        }
+
+
+        /*
+         * Returns the number of events.
+         */
+        inline std::size_t
+        size() const noexcept
+        {
+            return _tree.events;
+        }
+
+
+        /*
+         * Returns the version of the weights. It is incremented by two on
+         * every update.
+         *
+         * Throws:
+         *   std::runtime_error if the writer died in an update. The same
+         *   applies to all the functions that read the weights below.
+         */
+        std::uint64_t
+        version() const
+        {
+            return read([&] {
+                return _tree.sequence->load(std::memory_order_relaxed);
+            });
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         *
+         * Time complexity:
+         *   O(1) in absence of concurrent updates.
+         */
+        double
+        sum() const
+        {
+            return read([&] {
+                return _tree.load(0);
+            });
+        }
+
+
+        /*
+         * Returns the weight of the i-th event.
+         */
+        double
+        operator[](std::size_t i) const
+        {
+            DISTR_ASSERT(i < size());
+            return read([&] {
+                return _tree.load(_tree.leaves + i - 1);
+            });
+        }
+
+
+        /*
+         * Returns a consistent copy of the weights.
+         *
+         * Time complexity:
+         *   O(N) in absence of concurrent updates.
+         */
+        cxx::discrete_weights
+        snapshot() const
+        {
+            auto const tree_size = 2 * _tree.leaves - 1;
+            cxx::vector_storage<> storage{tree_size};
+
+            read([&] {
+                for (std::size_t node = 0; node < tree_size; node++) {
+                    storage.data()[node] = _tree.load(node);
+                }
+                return 0;
+            });
+
+            return cxx::discrete_weights{std::move(storage), _tree.events, _tree.leaves};
+        }
+
+
+        /*
+         * Finds the event whose cumulative weight interval covers given probe
+         * value. See `discrete_weights::find`.
+         *
+         * Time complexity:
+         *   O(log N) in absence of concurrent updates.
+         */
+        std::size_t
+        find(double probe) const
+        {
+            return read([&] {
+                return _tree.find(probe);
+            });
+        }
+
+
+        /*
+         * Samples an event with probability proportional to its weight. The
+         * sum and the search use the same version of the tree.
+         *
+         * Time complexity:
+         *   O(log N) in absence of concurrent updates.
+         */
+        template<typename RNG>
+        std::size_t
+        operator()(RNG& random) const
+        {
+            std::uniform_real_distribution<double> uniform{0.0, 1.0};
+            auto const u = uniform(random);
+
+            return read([&] {
+                return _tree.find(u * _tree.load(0));
+            });
+        }
+
+
+        /*
+         * Updates the weight of the i-th event. Only the writer may call
+         * this function.
+         *
+         * Time complexity:
+         *   O(log N).
+         *
+         * Throws:
+         *   std::logic_error if this object is a reader.
+         */
+        void
+        update(std::size_t i, double weight)
+        {
+            check_writable();
+            _tree.begin_write();
+            _tree.update(i, weight);
+            _tree.end_write();
+        }
+
+
+        /*
+         * Updates weights of multiple events as a single version. Readers
+         * observe either none or all of the updates. Only the writer may
+         * call this function.
+         *
+         * Params:
+         *   indices = Indices of events to update.
+         *   weights = New weights. Must have the same size as `indices`.
+         *
+         * Time complexity:
+         *   O(K log N) where K is the number of updated events.
+         *
+         * Throws:
+         *   std::logic_error if this object is a reader.
+         */
+        void
+        update(std::vector<std::size_t> const& indices, std::vector<double> const& weights)
+        {
+            check_writable();
+            DISTR_ASSERT(indices.size() == weights.size());
+            _tree.begin_write();
+            for (std::size_t k = 0; k < indices.size(); k++) {
+                _tree.update(indices[k], weights[k]);
+            }
+            _tree.end_write();
+        }
+
+
+    private:
+
+        static void
+        check_lock_free()
+        {
+            std::atomic<double> const probe{0.0};
+            std::atomic<std::uint64_t> const counter{0};
+
+            if (!probe.is_lock_free() || !counter.is_lock_free()) {
+                throw std::runtime_error{"lock-free atomics are not available"};
+            }
+        }
+
+
+        void
+        check_writable() const
+        {
+            if (!_writable) {
+                throw std::logic_error{"shared weights opened as reader"};
+            }
+        }
+
+
+        // Reads the tree under the sequence lock. Gives up if the same
+        // update stays in progress longer than the write timeout.
+        template<typename Read>
+        auto
+        read(Read read_fn) const -> decltype(read_fn())
+        {
+            using clock = std::chrono::steady_clock;
+
+            std::uint64_t stalled_sequence = 0;
+            clock::time_point stalled_since;
+
+            return _tree.read(read_fn, [&](std::uint64_t sequence) {
+                auto const now = clock::now();
+                if (sequence != stalled_sequence) {
+                    stalled_sequence = sequence;
+                    stalled_since = now;
+                } else if (now - stalled_since > _write_timeout) {
+                    throw std::runtime_error{"shared weights writer died in an update"};
+                }
+            });
+        }
+
+
+        void
+        map(int fd, std::size_t size, bool writable)
+        {
+            auto const prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            auto const map = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                throw std::system_error{errno, std::generic_category(), "mmap"};
+            }
+            _map = map;
+            _map_size = size;
+        }
+
+
+    private:
+        void* _map = nullptr;
+        std::size_t _map_size = 0;
+        detail::seqlock_sumtree _tree;
+        bool _writable = false;
+        std::chrono::nanoseconds _write_timeout = std::chrono::seconds{1};
+    };
+}
+
+#undef DISTR_ASSERT
+
+#endif
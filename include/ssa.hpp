@@ -0,0 +1,1110 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_SSA_HPP
+#define INCLUDED_SNSINFU_SSA_HPP
+
+// Stochastic simulation algorithm (Gillespie algorithm) built on top of
+// discrete_distribution.hpp, providing:
+//
+// - class cxx::ssa::reaction_network
+//   Stoichiometry and mass-action rate constants of a reaction network.
+//
+// - class cxx::ssa::direct_engine
+//   Simulator implementing Gillespie's direct method.
+//
+// - class cxx::ssa::next_reaction_engine
+//   Simulator implementing Gibson-Bruck's next reaction method.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "csr_graph.hpp"
+#include "discrete_distribution.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+namespace ssa
+{
+    /*
+     * Type used to count the number of molecules of a species.
+     */
+    using count_type = long;
+
+
+    /*
+     * Species and its stoichiometric coefficient in a reaction.
+     */
+    struct species_term
+    {
+        std::size_t species;
+        count_type count;
+    };
+
+
+    /*
+     * Contiguous range of species terms.
+     */
+    struct term_range
+    {
+        species_term const* first;
+        species_term const* last;
+
+        inline species_term const*
+        begin() const noexcept
+        {
+            return first;
+        }
+
+        inline species_term const*
+        end() const noexcept
+        {
+            return last;
+        }
+    };
+
+
+    // NETWORK ---------------------------------------------------------------
+
+    /*
+     * Reaction network obeying mass action kinetics. Each reaction consumes
+     * reactants and yields products, and its propensity is
+     *
+     *   a = k * prod_s C(x[s], n[s])
+     *
+     * where k is the rate constant, x[s] the count of reactant species s,
+     * n[s] its stoichiometric coefficient and C the binomial coefficient.
+     * A catalyst is expressed by listing the same species on both sides.
+     */
+    class reaction_network
+    {
+    public:
+
+        /*
+         * Default constructor creates an empty network.
+         */
+        reaction_network() = default;
+
+
+        /*
+         * Creates a network of given number of species without reactions.
+         */
+        explicit
+        reaction_network(std::size_t species)
+            : _species{species}
+        {
+        }
+
+
+        /*
+         * Returns the number of species.
+         */
+        inline std::size_t
+        species() const noexcept
+        {
+            return _species;
+        }
+
+
+        /*
+         * Returns the number of reactions.
+         */
+        inline std::size_t
+        reactions() const noexcept
+        {
+            return _rates.size();
+        }
+
+
+        /*
+         * Adds a reaction to the network.
+         *
+         * Params:
+         *   rate      = Rate constant. Must be non-negative finite number.
+         *   reactants = Species consumed by the reaction.
+         *   products  = Species produced by the reaction.
+         *
+         * Returns:
+         *   The index of the added reaction.
+         */
+        std::size_t
+        add_reaction(
+            double rate,
+            std::vector<species_term> const& reactants,
+            std::vector<species_term> const& products
+        )
+        {
+            DISTR_ASSERT(rate >= 0);
+
+            for (auto const& term : reactants) {
+                DISTR_ASSERT(term.species < _species);
+                DISTR_ASSERT(term.count > 0);
+                _reactants.push_back(term);
+            }
+            _reactant_offsets.push_back(_reactants.size());
+
+            // Store net changes of species so that firing a reaction does
+            // not touch catalysts.
+            auto const change_start = _changes.size();
+
+            auto const accumulate = [&](species_term const& term, count_type sign) {
+                DISTR_ASSERT(term.species < _species);
+
+                for (auto i = change_start; i < _changes.size(); i++) {
+                    if (_changes[i].species == term.species) {
+                        _changes[i].count += sign * term.count;
+                        return;
+                    }
+                }
+                _changes.push_back(species_term{term.species, sign * term.count});
+            };
+
+            for (auto const& term : reactants) {
+                accumulate(term, -1);
+            }
+            for (auto const& term : products) {
+                accumulate(term, +1);
+            }
+
+            auto const change_end = std::remove_if(
+                _changes.begin() + std::ptrdiff_t(change_start),
+                _changes.end(),
+                [](species_term const& term) { return term.count == 0; }
+            );
+            _changes.erase(change_end, _changes.end());
+            _change_offsets.push_back(_changes.size());
+
+            _rates.push_back(rate);
+
+            return _rates.size() - 1;
+        }
+
+
+        /*
+         * Returns the rate constant of the r-th reaction.
+         */
+        inline double
+        rate(std::size_t r) const
+        {
+            return _rates[r];
+        }
+
+
+        /*
+         * Returns the reactants of the r-th reaction.
+         */
+        inline term_range
+        reactants(std::size_t r) const
+        {
+            return term_range{
+                _reactants.data() + _reactant_offsets[r],
+                _reactants.data() + _reactant_offsets[r + 1]
+            };
+        }
+
+
+        /*
+         * Returns the net changes of species counts caused by the r-th
+         * reaction. Species whose count does not change are omitted.
+         */
+        inline term_range
+        changes(std::size_t r) const
+        {
+            return term_range{
+                _changes.data() + _change_offsets[r],
+                _changes.data() + _change_offsets[r + 1]
+            };
+        }
+
+
+        /*
+         * Computes the propensity of the r-th reaction.
+         *
+         * Params:
+         *   r      = Index of the reaction.
+         *   counts = Pointer to the species counts.
+         */
+        double
+        propensity(std::size_t r, count_type const* counts) const
+        {
+            double a = _rates[r];
+
+            for (auto const& term : reactants(r)) {
+                auto const x = counts[term.species];
+
+                for (count_type k = 0; k < term.count; k++) {
+                    if (x - k <= 0) {
+                        return 0;
+                    }
+                    a *= double(x - k) / double(k + 1);
+                }
+            }
+
+            return a;
+        }
+
+
+        /*
+         * Returns a copy of the network with reactions renumbered.
+         *
+         * Params:
+         *   order = Permutation of reaction indices. The k-th reaction of the
+         *           returned network is the `order[k]`-th reaction of this
+         *           network.
+         */
+        reaction_network
+        permuted(std::vector<std::size_t> const& order) const
+        {
+            DISTR_ASSERT(order.size() == reactions());
+
+            reaction_network network{_species};
+            network._rates.reserve(_rates.size());
+            network._reactants.reserve(_reactants.size());
+            network._changes.reserve(_changes.size());
+
+            for (auto const r : order) {
+                network._rates.push_back(_rates[r]);
+
+                for (auto const& term : reactants(r)) {
+                    network._reactants.push_back(term);
+                }
+                network._reactant_offsets.push_back(network._reactants.size());
+
+                for (auto const& term : changes(r)) {
+                    network._changes.push_back(term);
+                }
+                network._change_offsets.push_back(network._changes.size());
+            }
+
+            return network;
+        }
+
+
+    private:
+        std::size_t _species = 0;
+        std::vector<double> _rates;
+        std::vector<species_term> _reactants;
+        std::vector<std::size_t> _reactant_offsets = {0};
+        std::vector<species_term> _changes;
+        std::vector<std::size_t> _change_offsets = {0};
+    };
+
+
+    /*
+     * Computes an ordering of reactions that places reactions sharing a
+     * reactant species next to each other. Those reactions are updated
+     * together when the species changes, so simulating the reordered
+     * network touches fewer distinct paths of the propensity tree.
+     *
+     * The ordering is the reverse Cuthill-McKee ordering of the bipartite
+     * graph of species and reactions, restricted to reactions.
+     *
+     * Returns:
+     *   Permutation to pass to `reaction_network::permuted`. The k-th
+     *   reaction of the reordered network is the `order[k]`-th reaction of
+     *   the original network.
+     */
+    inline std::vector<std::size_t>
+    locality_order(reaction_network const& network)
+    {
+        auto const num_species = network.species();
+        auto const num_reactions = network.reactions();
+
+        // Nodes [0, S) are species and [S, S+R) are reactions.
+        cxx::csr_graph_builder builder{num_species + num_reactions};
+
+        for (std::size_t r = 0; r < num_reactions; r++) {
+            for (auto const& term : network.reactants(r)) {
+                builder.count(term.species);
+                builder.count(num_species + r);
+            }
+        }
+        for (std::size_t r = 0; r < num_reactions; r++) {
+            for (auto const& term : network.reactants(r)) {
+                builder.insert(term.species, num_species + r);
+                builder.insert(num_species + r, term.species);
+            }
+        }
+
+        auto const node_order = cxx::reverse_cuthill_mckee(builder.finish());
+
+        std::vector<std::size_t> order;
+        order.reserve(num_reactions);
+
+        for (auto const node : node_order) {
+            if (node >= num_species) {
+                order.push_back(node - num_species);
+            }
+        }
+
+        return order;
+    }
+
+
+    namespace detail
+    {
+        /*
+         * Computes, for each reaction r, the reactions whose propensities
+         * change when r fires. Each list is free of duplicates.
+         */
+        inline cxx::csr_graph
+        make_reaction_dependencies(reaction_network const& network)
+        {
+            auto const num_species = network.species();
+            auto const num_reactions = network.reactions();
+
+            // Invert the reactant lists: species -> reactions.
+            cxx::csr_graph_builder consumers_builder{num_species};
+
+            for (std::size_t r = 0; r < num_reactions; r++) {
+                for (auto const& term : network.reactants(r)) {
+                    consumers_builder.count(term.species);
+                }
+            }
+            for (std::size_t r = 0; r < num_reactions; r++) {
+                for (auto const& term : network.reactants(r)) {
+                    consumers_builder.insert(term.species, r);
+                }
+            }
+
+            auto const consumers = consumers_builder.finish();
+
+            // Compose changes with consumers: reaction -> reactions. The
+            // stamp array marks reactions already listed for the current
+            // reaction, so shared dependents are listed only once. Both
+            // passes must produce the same edges, so stamps are reset.
+            cxx::csr_graph_builder deps_builder{num_reactions};
+            std::vector<std::size_t> stamp;
+
+            for (int pass = 0; pass < 2; pass++) {
+                stamp.assign(num_reactions, std::size_t(-1));
+
+                for (std::size_t r = 0; r < num_reactions; r++) {
+                    for (auto const& term : network.changes(r)) {
+                        for (auto const dep : consumers.neighbors(term.species)) {
+                            if (stamp[dep] == r) {
+                                continue;
+                            }
+                            stamp[dep] = r;
+
+                            if (pass == 0) {
+                                deps_builder.count(r);
+                            } else {
+                                deps_builder.insert(r, dep);
+                            }
+                        }
+                    }
+                }
+            }
+
+            return deps_builder.finish();
+        }
+
+
+        /*
+         * Immutable part of an engine: the network and the dependencies
+         * between its reactions. Copies of an engine share it.
+         */
+        struct reaction_model
+        {
+            reaction_network network;
+            cxx::csr_graph dependencies;
+
+            explicit
+            reaction_model(reaction_network const& source)
+                : network{source}
+                , dependencies{make_reaction_dependencies(source)}
+            {
+            }
+        };
+
+
+        /*
+         * Observer that does nothing.
+         */
+        struct null_observer
+        {
+            template<typename Engine>
+            void
+            operator()(Engine const&, std::size_t) const noexcept
+            {
+            }
+        };
+
+
+        /*
+         * Binary min-heap of keys indexed by item number. Keys of arbitrary
+         * items can be changed in O(log N) time.
+         */
+        class indexed_heap
+        {
+        public:
+
+            indexed_heap() = default;
+
+
+            /*
+             * Creates a heap of items `0, ..., keys.size()-1` with given
+             * keys in O(N) time.
+             */
+            explicit
+            indexed_heap(std::vector<double> const& keys)
+                : _keys{keys}
+                , _heap(keys.size())
+                , _position(keys.size())
+            {
+                for (std::size_t i = 0; i < _heap.size(); i++) {
+                    _heap[i] = i;
+                    _position[i] = i;
+                }
+
+                for (auto node = _heap.size() / 2; node > 0; node--) {
+                    sift_down(node - 1);
+                }
+            }
+
+
+            inline std::size_t
+            size() const noexcept
+            {
+                return _heap.size();
+            }
+
+
+            /*
+             * Returns the item with the smallest key.
+             */
+            inline std::size_t
+            top() const
+            {
+                DISTR_ASSERT(!_heap.empty());
+                return _heap[0];
+            }
+
+
+            /*
+             * Returns the key of the item.
+             */
+            inline double
+            key(std::size_t item) const
+            {
+                return _keys[item];
+            }
+
+
+            /*
+             * Changes the key of the item and restores the heap order.
+             */
+            void
+            update(std::size_t item, double key)
+            {
+                auto const old_key = _keys[item];
+                _keys[item] = key;
+
+                if (key < old_key) {
+                    sift_up(_position[item]);
+                } else {
+                    sift_down(_position[item]);
+                }
+            }
+
+
+        private:
+
+            void
+            sift_up(std::size_t node)
+            {
+                auto const item = _heap[node];
+                auto const key = _keys[item];
+
+                while (node > 0) {
+                    auto const parent = (node - 1) / 2;
+                    if (!(key < _keys[_heap[parent]])) {
+                        break;
+                    }
+                    place(node, _heap[parent]);
+                    node = parent;
+                }
+                place(node, item);
+            }
+
+
+            void
+            sift_down(std::size_t node)
+            {
+                auto const item = _heap[node];
+                auto const key = _keys[item];
+
+                for (;;) {
+                    auto child = 2 * node + 1;
+                    if (child >= _heap.size()) {
+                        break;
+                    }
+                    if (child + 1 < _heap.size() &&
+                        _keys[_heap[child + 1]] < _keys[_heap[child]]) {
+                        child++;
+                    }
+                    if (!(_keys[_heap[child]] < key)) {
+                        break;
+                    }
+                    place(node, _heap[child]);
+                    node = child;
+                }
+                place(node, item);
+            }
+
+
+            inline void
+            place(std::size_t node, std::size_t item)
+            {
+                _heap[node] = item;
+                _position[item] = node;
+            }
+
+
+        private:
+            std::vector<double> _keys;
+            std::vector<std::size_t> _heap;
+            std::vector<std::size_t> _position;
+        };
+    }
+
+
+    // DIRECT METHOD ---------------------------------------------------------
+
+    /*
+     * Stochastic simulator implementing Gillespie's direct method. The
+     * engine owns the species counts, the propensity distribution and a
+     * random number generator, and shares an immutable copy of the network
+     * with its copies. So copying an engine does not copy the network or
+     * the reaction dependencies.
+     */
+    template<typename RNG = std::mt19937_64>
+    class direct_engine
+    {
+    public:
+
+        /*
+         * Type of the random number generator.
+         */
+        using random_engine = RNG;
+
+
+        /*
+         * Creates an engine.
+         *
+         * Params:
+         *   network = Reaction network to simulate.
+         *   counts  = Initial counts of the species. The size must equal
+         *             the number of species in the network.
+         *   random  = Random number generator.
+         *
+         * Time complexity:
+         *   O(N + D) where N is the number of reactions and D is the total
+         *   number of dependencies between reactions.
+         */
+        direct_engine(
+            reaction_network const& network,
+            std::vector<count_type> const& counts,
+            RNG const& random = RNG{}
+        )
+            : _model{std::make_shared<detail::reaction_model const>(network)}
+            , _counts{counts}
+            , _random{random}
+        {
+            DISTR_ASSERT(_counts.size() == network.species());
+
+            std::vector<double> propensities(network.reactions());
+            for (std::size_t r = 0; r < propensities.size(); r++) {
+                propensities[r] = network.propensity(r, _counts.data());
+            }
+            _propensities = cxx::discrete_distribution<std::size_t>{propensities};
+        }
+
+
+        /*
+         * Returns the simulated time.
+         */
+        inline double
+        time() const noexcept
+        {
+            return _time;
+        }
+
+
+        /*
+         * Returns the number of reactions fired so far.
+         */
+        inline std::size_t
+        steps() const noexcept
+        {
+            return _steps;
+        }
+
+
+        /*
+         * Returns the current species counts.
+         */
+        inline std::vector<count_type> const&
+        counts() const noexcept
+        {
+            return _counts;
+        }
+
+
+        /*
+         * Returns the current propensities of the reactions.
+         */
+        inline cxx::discrete_weights const&
+        propensities() const noexcept
+        {
+            return _propensities.param();
+        }
+
+
+        /*
+         * Returns the simulated network.
+         */
+        inline reaction_network const&
+        network() const noexcept
+        {
+            return _model->network;
+        }
+
+
+        /*
+         * Returns the random number generator.
+         */
+        inline RNG&
+        random() noexcept
+        {
+            return _random;
+        }
+
+
+        /*
+         * Advances the simulation by one reaction.
+         *
+         * Returns:
+         *   False if no reaction can fire, true otherwise.
+         *
+         * Time complexity:
+         *   O(d log N) where N is the number of reactions and d is the
+         *   number of reactions depending on the fired one.
+         */
+        bool
+        step()
+        {
+            auto const total = _propensities.sum();
+            if (total <= 0) {
+                return false;
+            }
+
+            std::exponential_distribution<double> wait{total};
+            _time += wait(_random);
+            fire(_propensities(_random));
+
+            return true;
+        }
+
+
+        /*
+         * Runs the simulation until given time. A reaction scheduled beyond
+         * `t_end` is discarded, so the simulated time becomes exactly
+         * `t_end` on return.
+         *
+         * Params:
+         *   t_end    = Time to stop the simulation.
+         *   observer = Function called as `observer(engine, reaction)` after
+         *              each reaction fires.
+         *
+         * Returns:
+         *   The number of reactions fired.
+         */
+        template<typename Observer>
+        std::size_t
+        run_until(double t_end, Observer observer)
+        {
+            std::size_t fired = 0;
+
+            while (_time < t_end) {
+                auto const total = _propensities.sum();
+                if (total <= 0) {
+                    break;
+                }
+
+                std::exponential_distribution<double> wait{total};
+                auto const next_time = _time + wait(_random);
+                if (next_time > t_end) {
+                    break;
+                }
+                _time = next_time;
+
+                auto const reaction = _propensities(_random);
+                fire(reaction);
+                fired++;
+
+                observer(static_cast<direct_engine const&>(*this), reaction);
+            }
+
+            if (_time < t_end) {
+                _time = t_end;
+            }
+
+            return fired;
+        }
+
+
+        /*
+         * Runs the simulation until given time without observation.
+         */
+        std::size_t
+        run_until(double t_end)
+        {
+            return run_until(t_end, detail::null_observer{});
+        }
+
+
+    private:
+
+        void
+        fire(std::size_t reaction)
+        {
+            auto const& network = _model->network;
+
+            for (auto const& term : network.changes(reaction)) {
+                _counts[term.species] += term.count;
+                DISTR_ASSERT(_counts[term.species] >= 0);
+            }
+
+            for (auto const dep : _model->dependencies.neighbors(reaction)) {
+                _propensities.update(dep, network.propensity(dep, _counts.data()));
+            }
+
+            _steps++;
+        }
+
+
+    private:
+        std::shared_ptr<detail::reaction_model const> _model;
+        std::vector<count_type> _counts;
+        cxx::discrete_distribution<std::size_t> _propensities;
+        RNG _random;
+        double _time = 0;
+        std::size_t _steps = 0;
+    };
+
+    // NEXT REACTION METHOD --------------------------------------------------
+
+    /*
+     * Stochastic simulator implementing the next reaction method of Gibson
+     * and Bruck. The engine keeps the absolute firing time of every reaction
+     * in an indexed priority queue and reuses the waiting times of affected
+     * reactions by rescaling, so each step consumes one random number.
+     *
+     * The engine is faster than `direct_engine` when few propensities
+     * change per step relative to the network size. Like `direct_engine`,
+     * copies of an engine share the network and the reaction dependencies.
+     */
+    template<typename RNG = std::mt19937_64>
+    class next_reaction_engine
+    {
+    public:
+
+        /*
+         * Type of the random number generator.
+         */
+        using random_engine = RNG;
+
+
+        /*
+         * Creates an engine.
+         *
+         * Params:
+         *   network = Reaction network to simulate.
+         *   counts  = Initial counts of the species. The size must equal
+         *             the number of species in the network.
+         *   random  = Random number generator.
+         *
+         * Time complexity:
+         *   O(N + D) where N is the number of reactions and D is the total
+         *   number of dependencies between reactions.
+         */
+        next_reaction_engine(
+            reaction_network const& network,
+            std::vector<count_type> const& counts,
+            RNG const& random = RNG{}
+        )
+            : _model{std::make_shared<detail::reaction_model const>(network)}
+            , _counts{counts}
+            , _random{random}
+        {
+            DISTR_ASSERT(_counts.size() == network.species());
+
+            _propensities.resize(network.reactions());
+            std::vector<double> firing_times(network.reactions());
+
+            for (std::size_t r = 0; r < _propensities.size(); r++) {
+                _propensities[r] = network.propensity(r, _counts.data());
+                firing_times[r] = draw_firing_time(_propensities[r]);
+            }
+            _schedule = detail::indexed_heap{firing_times};
+        }
+
+
+        /*
+         * Returns the simulated time.
+         */
+        inline double
+        time() const noexcept
+        {
+            return _time;
+        }
+
+
+        /*
+         * Returns the number of reactions fired so far.
+         */
+        inline std::size_t
+        steps() const noexcept
+        {
+            return _steps;
+        }
+
+
+        /*
+         * Returns the current species counts.
+         */
+        inline std::vector<count_type> const&
+        counts() const noexcept
+        {
+            return _counts;
+        }
+
+
+        /*
+         * Returns the current propensities of the reactions.
+         */
+        inline std::vector<double> const&
+        propensities() const noexcept
+        {
+            return _propensities;
+        }
+
+
+        /*
+         * Returns the simulated network.
+         */
+        inline reaction_network const&
+        network() const noexcept
+        {
+            return _model->network;
+        }
+
+
+        /*
+         * Returns the random number generator.
+         */
+        inline RNG&
+        random() noexcept
+        {
+            return _random;
+        }
+
+
+        /*
+         * Advances the simulation by one reaction.
+         *
+         * Returns:
+         *   False if no reaction can fire, true otherwise.
+         *
+         * Time complexity:
+         *   O(d log N) where N is the number of reactions and d is the
+         *   number of reactions depending on the fired one.
+         */
+        bool
+        step()
+        {
+            if (_schedule.size() == 0) {
+                return false;
+            }
+
+            auto const reaction = _schedule.top();
+            auto const next_time = _schedule.key(reaction);
+            if (next_time == infinity()) {
+                return false;
+            }
+
+            _time = next_time;
+            fire(reaction);
+
+            return true;
+        }
+
+
+        /*
+         * Runs the simulation until given time. The simulated time becomes
+         * exactly `t_end` on return.
+         *
+         * Params:
+         *   t_end    = Time to stop the simulation.
+         *   observer = Function called as `observer(engine, reaction)` after
+         *              each reaction fires.
+         *
+         * Returns:
+         *   The number of reactions fired.
+         */
+        template<typename Observer>
+        std::size_t
+        run_until(double t_end, Observer observer)
+        {
+            std::size_t fired = 0;
+
+            while (_schedule.size() > 0) {
+                auto const reaction = _schedule.top();
+                auto const next_time = _schedule.key(reaction);
+
+                // Reactions that cannot fire are scheduled at infinity, which
+                // does not exceed an infinite t_end.
+                if (next_time > t_end || next_time == infinity()) {
+                    break;
+                }
+                _time = next_time;
+
+                fire(reaction);
+                fired++;
+
+                observer(static_cast<next_reaction_engine const&>(*this), reaction);
+            }
+
+            if (_time < t_end) {
+                _time = t_end;
+            }
+
+            return fired;
+        }
+
+
+        /*
+         * Runs the simulation until given time without observation.
+         */
+        std::size_t
+        run_until(double t_end)
+        {
+            return run_until(t_end, detail::null_observer{});
+        }
+
+
+    private:
+
+        static constexpr double
+        infinity() noexcept
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+
+
+        double
+        draw_firing_time(double propensity)
+        {
+            if (propensity <= 0) {
+                return infinity();
+            }
+            std::exponential_distribution<double> wait{propensity};
+            return _time + wait(_random);
+        }
+
+
+        void
+        fire(std::size_t reaction)
+        {
+            auto const& network = _model->network;
+
+            for (auto const& term : network.changes(reaction)) {
+                _counts[term.species] += term.count;
+                DISTR_ASSERT(_counts[term.species] >= 0);
+            }
+
+            for (auto const dep : _model->dependencies.neighbors(reaction)) {
+                if (dep == reaction) {
+                    continue;
+                }
+
+                auto const old_propensity = _propensities[dep];
+                auto const new_propensity = network.propensity(dep, _counts.data());
+                _propensities[dep] = new_propensity;
+
+                // Rescale the remaining waiting time if the reaction was
+                // scheduled. Otherwise draw a fresh one, which is valid
+                // because the exponential distribution is memoryless.
+                double firing_time;
+
+                if (old_propensity > 0 && new_propensity > 0) {
+                    auto const remaining = _schedule.key(dep) - _time;
+                    firing_time = _time + remaining * (old_propensity / new_propensity);
+                } else {
+                    firing_time = draw_firing_time(new_propensity);
+                }
+                _schedule.update(dep, firing_time);
+            }
+
+            // The fired reaction always needs a fresh waiting time.
+            _propensities[reaction] = network.propensity(reaction, _counts.data());
+            _schedule.update(reaction, draw_firing_time(_propensities[reaction]));
+
+            _steps++;
+        }
+
+
+    private:
+        std::shared_ptr<detail::reaction_model const> _model;
+        std::vector<count_type> _counts;
+        std::vector<double> _propensities;
+        detail::indexed_heap _schedule;
+        RNG _random;
+        double _time = 0;
+        std::size_t _steps = 0;
+    };
+}
+}
+
+#undef DISTR_ASSERT
+
+#endif
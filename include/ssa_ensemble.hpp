@@ -0,0 +1,368 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_SSA_ENSEMBLE_HPP
+#define INCLUDED_SNSINFU_SSA_ENSEMBLE_HPP
+
+// Parallel execution of independent SSA replicates, providing:
+//
+// - class cxx::ssa::ensemble_runner
+//   Runs replicates of a prototype engine across threads.
+//
+// Programs using this header need to be linked with the platform thread
+// library (e.g. `-pthread`).
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ssa.hpp"
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+namespace ssa
+{
+    namespace detail
+    {
+        /*
+         * Seeds a random number generator with a stream determined only by
+         * the master seed and the replicate index.
+         */
+        template<typename RNG>
+        void
+        seed_stream(RNG& random, std::uint64_t seed, std::uint64_t stream)
+        {
+            std::seed_seq seq{
+                std::uint32_t(seed),
+                std::uint32_t(seed >> 32),
+                std::uint32_t(stream),
+                std::uint32_t(stream >> 32)
+            };
+            random.seed(seq);
+        }
+
+
+        /*
+         * Half-open range of task indices shared by an owner thread and
+         * thieves. The owner takes tasks from the front and thieves take
+         * tasks from the back. Both ends are packed into a single atomic
+         * word so that either operation is a single CAS. Aligned to a cache
+         * line so that ranges of different threads do not share a line.
+         * Operator new does not honor the alignment before C++17, so ranges
+         * are placed in a buffer aligned by hand; see `make_task_ranges`.
+         */
+        class alignas(64) task_range
+        {
+        public:
+
+            void
+            assign(std::uint32_t begin, std::uint32_t end) noexcept
+            {
+                _bounds.store(pack(begin, end), std::memory_order_relaxed);
+            }
+
+
+            bool
+            take_front(std::size_t& task) noexcept
+            {
+                auto bounds = _bounds.load(std::memory_order_relaxed);
+
+                for (;;) {
+                    auto const begin = std::uint32_t(bounds >> 32);
+                    auto const end = std::uint32_t(bounds);
+                    if (begin >= end) {
+                        return false;
+                    }
+                    if (_bounds.compare_exchange_weak(bounds, pack(begin + 1, end))) {
+                        task = begin;
+                        return true;
+                    }
+                }
+            }
+
+
+            bool
+            take_back(std::size_t& task) noexcept
+            {
+                auto bounds = _bounds.load(std::memory_order_relaxed);
+
+                for (;;) {
+                    auto const begin = std::uint32_t(bounds >> 32);
+                    auto const end = std::uint32_t(bounds);
+                    if (begin >= end) {
+                        return false;
+                    }
+                    if (_bounds.compare_exchange_weak(bounds, pack(begin, end - 1))) {
+                        task = end - 1;
+                        return true;
+                    }
+                }
+            }
+
+
+        private:
+
+            static std::uint64_t
+            pack(std::uint32_t begin, std::uint32_t end) noexcept
+            {
+                return std::uint64_t(begin) << 32 | end;
+            }
+
+
+        private:
+            std::atomic<std::uint64_t> _bounds{0};
+        };
+
+        static_assert(
+            std::is_trivially_destructible<task_range>::value,
+            "task ranges are released without running destructors"
+        );
+
+
+        // Allocates `count` task ranges aligned to a cache line in `buffer`.
+        inline task_range*
+        make_task_ranges(std::unique_ptr<char[]>& buffer, std::size_t count)
+        {
+            auto const size = count * sizeof(task_range);
+            auto space = size + alignof(task_range);
+            buffer.reset(new char[space]);
+
+            void* ptr = buffer.get();
+            std::align(alignof(task_range), size, ptr, space);
+
+            auto const ranges = static_cast<task_range*>(ptr);
+            for (std::size_t w = 0; w < count; w++) {
+                new(ranges + w) task_range;
+            }
+            return ranges;
+        }
+    }
+
+
+    // ENSEMBLE --------------------------------------------------------------
+
+    /*
+     * Runs independent replicates of a simulation across threads.
+     *
+     * Each worker thread holds a single engine object. For each replicate
+     * the worker copy-assigns the prototype engine into it, which copies
+     * the counts and the propensities into the existing buffers without
+     * rebuilding anything and shares the immutable network and dependency
+     * graph with the prototype, and then reseeds the engine's random number
+     * generator with a stream derived from the master seed and the
+     * replicate index. Results therefore do not depend on the number of
+     * threads or on scheduling.
+     *
+     * Replicates are initially split evenly among workers, and a worker that
+     * runs out of replicates steals from the back of the others' ranges.
+     */
+    class ensemble_runner
+    {
+    public:
+
+        /*
+         * Creates a runner.
+         *
+         * Params:
+         *   threads = Number of worker threads including the calling thread.
+         *             Zero means the number of hardware threads.
+         */
+        explicit
+        ensemble_runner(unsigned threads = 0)
+            : _threads{threads}
+        {
+            if (_threads == 0) {
+                _threads = std::thread::hardware_concurrency();
+            }
+            if (_threads == 0) {
+                _threads = 1;
+            }
+        }
+
+
+        /*
+         * Returns the number of worker threads.
+         */
+        inline unsigned
+        threads() const noexcept
+        {
+            return _threads;
+        }
+
+
+        /*
+         * Runs replicates of a simulation.
+         *
+         * Params:
+         *   prototype  = Engine in the initial state. Copied for each
+         *                replicate.
+         *   replicates = Number of replicates to run. Must be less than 2^32.
+         *   seed       = Master seed of the random number streams.
+         *   function   = Function called as `function(engine, index)` for
+         *                each replicate. It runs the simulation and returns
+         *                the output of the replicate. The output type must
+         *                be default constructible and must not be `bool`.
+         *
+         * Returns:
+         *   Vector of outputs indexed by replicate. Each output is written
+         *   to its own slot by exactly one thread, so no locking is needed.
+         *
+         * Throws:
+         *   std::length_error if `replicates` is 2^32 or more. Otherwise the
+         *   exception thrown first in time by `function`, or by the creation
+         *   of a worker thread, after all started workers stop. Remaining
+         *   replicates are not run.
+         */
+        template<typename Engine, typename Function>
+        auto
+        run(
+            Engine const& prototype,
+            std::size_t replicates,
+            std::uint64_t seed,
+            Function function
+        ) const
+            -> std::vector<decltype(function(std::declval<Engine&>(), std::size_t()))>
+        {
+            using result_type = decltype(function(std::declval<Engine&>(), std::size_t()));
+
+            if (replicates > std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error{"too many replicates"};
+            }
+
+            std::vector<result_type> results(replicates);
+
+            auto const workers = std::size_t(_threads) < replicates
+                ? std::size_t(_threads)
+                : std::max(replicates, std::size_t(1));
+
+            std::unique_ptr<char[]> range_buffer;
+            auto const ranges = detail::make_task_ranges(range_buffer, workers);
+            for (std::size_t w = 0; w < workers; w++) {
+                ranges[w].assign(
+                    std::uint32_t(replicates * w / workers),
+                    std::uint32_t(replicates * (w + 1) / workers)
+                );
+            }
+
+            // Only the worker that raises the flag records its exception,
+            // so the one reported is the first thrown.
+            std::exception_ptr error;
+            std::atomic<bool> failed{false};
+
+            auto const work = [&](std::size_t self) {
+                try {
+                    Engine engine = prototype;
+                    std::size_t task;
+
+                    for (;;) {
+                        if (failed.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+
+                        bool found = ranges[self].take_front(task);
+
+                        for (std::size_t i = 1; !found && i < workers; i++) {
+                            found = ranges[(self + i) % workers].take_back(task);
+                        }
+                        if (!found) {
+                            return;
+                        }
+
+                        engine = prototype;
+                        detail::seed_stream(engine.random(), seed, task);
+                        results[task] = function(engine, task);
+                    }
+                } catch (...) {
+                    if (!failed.exchange(true)) {
+                        error = std::current_exception();
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+
+            // Destroying a joinable thread terminates the program, so the
+            // started workers are stopped and joined before an exception
+            // from thread creation propagates.
+            auto const join_all = [&] {
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+            };
+
+            try {
+                threads.reserve(workers - 1);
+
+                for (std::size_t w = 1; w < workers; w++) {
+                    threads.emplace_back(work, w);
+                }
+            } catch (...) {
+                failed.store(true);
+                join_all();
+                throw;
+            }
+
+            work(0);
+            join_all();
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            return results;
+        }
+
+
+    private:
+        unsigned _threads;
+    };
+}
+}
+
+#undef DISTR_ASSERT
+
+#endif
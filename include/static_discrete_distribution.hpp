@@ -0,0 +1,482 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INCLUDED_SNSINFU_STATIC_DISCRETE_DISTRIBUTION_HPP
+#define INCLUDED_SNSINFU_STATIC_DISCRETE_DISTRIBUTION_HPP
+
+// Discrete distribution over a number of events fixed at compile time,
+// providing:
+//
+// - class cxx::static_discrete_distribution<N, T>
+//   Discrete distribution with N events stored inline without allocation.
+//
+// See: https://github.com/snsinfu/cxx-distr/
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <random>
+#include <type_traits>
+
+
+#ifdef DISTR_DEBUG
+#  define DISTR_ASSERT(pred) assert(pred)
+#else
+#  define DISTR_ASSERT(pred)
+#endif
+
+
+namespace cxx
+{
+    namespace detail
+    {
+        // Sequence of indices for C++11, where std::index_sequence is not
+        // available. make_static_indices<N>::type is static_indices<0, ...,
+        // N-1>, built with logarithmic recursion depth.
+        template<std::size_t... I>
+        struct static_indices
+        {
+        };
+
+        template<typename A, typename B>
+        struct concat_static_indices;
+
+        template<std::size_t... I, std::size_t... J>
+        struct concat_static_indices<static_indices<I...>, static_indices<J...>>
+        {
+            using type = static_indices<I..., (sizeof...(I) + J)...>;
+        };
+
+        template<std::size_t N>
+        struct make_static_indices
+        {
+            using type = typename concat_static_indices<
+                typename make_static_indices<N / 2>::type,
+                typename make_static_indices<N - N / 2>::type
+            >::type;
+        };
+
+        template<>
+        struct make_static_indices<0>
+        {
+            using type = static_indices<>;
+        };
+
+        template<>
+        struct make_static_indices<1>
+        {
+            using type = static_indices<0>;
+        };
+
+
+        // Returns the smallest power of two not less than `events`. Same as
+        // `sumtree_leaves`, but usable in constant expressions.
+        constexpr std::size_t
+        static_sumtree_leaves(std::size_t events, std::size_t leaves = 1)
+        {
+            return leaves >= events ? leaves : static_sumtree_leaves(events, leaves * 2);
+        }
+
+
+        // Returns floor(log2(n)) for positive n.
+        constexpr std::size_t
+        static_log2(std::size_t n)
+        {
+            return n <= 1 ? 0 : 1 + static_log2(n / 2);
+        }
+
+
+        // Returns the sum of weights[begin:end] padded with zeros beyond
+        // `events`, added in the same order as `build_sumtree` so that the
+        // result is bitwise identical to the runtime-built tree.
+        constexpr double
+        static_range_sum(
+            double const* weights,
+            std::size_t events,
+            std::size_t begin,
+            std::size_t end
+        )
+        {
+            return end - begin == 1
+                ? (begin < events ? weights[begin] : 0.0)
+                : static_range_sum(weights, events, begin, begin + (end - begin) / 2)
+                  + static_range_sum(weights, events, begin + (end - begin) / 2, end);
+        }
+
+
+        // Returns the value of a node of the sum tree with given number of
+        // leaves. The node at depth d covers `leaves >> d` leaves.
+        constexpr double
+        static_node_sum(
+            double const* weights,
+            std::size_t events,
+            std::size_t leaves,
+            std::size_t node
+        )
+        {
+            return static_range_sum(
+                weights,
+                events,
+                (node + 1 - (std::size_t(1) << static_log2(node + 1))) * (leaves >> static_log2(node + 1)),
+                (node + 2 - (std::size_t(1) << static_log2(node + 1))) * (leaves >> static_log2(node + 1))
+            );
+        }
+
+
+        // Descends given number of levels of a sum tree without branches.
+        // The recursion is resolved at compile time, so the loop is fully
+        // unrolled.
+        inline void
+        static_descend(
+            double const*,
+            std::size_t&,
+            double&,
+            std::integral_constant<std::size_t, 0>
+        ) noexcept
+        {
+        }
+
+        template<std::size_t Levels>
+        inline void
+        static_descend(
+            double const* tree,
+            std::size_t& node,
+            double& probe,
+            std::integral_constant<std::size_t, Levels>
+        ) noexcept
+        {
+            auto const lchild = 2 * node + 1;
+            auto const left = tree[lchild];
+            auto const right = !(probe < left);
+
+            // Multiplying instead of selecting keeps compilers from
+            // emitting a branch. left * 0.0 is zero as weights are finite.
+            probe -= left * double(right);
+            node = lchild + std::size_t(right);
+
+            static_descend(tree, node, probe, std::integral_constant<std::size_t, Levels - 1>{});
+        }
+
+
+        // Recomputes given number of ancestors of a node, fully unrolled.
+        inline void
+        static_ascend(
+            double*,
+            std::size_t,
+            std::integral_constant<std::size_t, 0>
+        ) noexcept
+        {
+        }
+
+        template<std::size_t Levels>
+        inline void
+        static_ascend(
+            double* tree,
+            std::size_t node,
+            std::integral_constant<std::size_t, Levels>
+        ) noexcept
+        {
+            auto const parent = (node - 1) / 2;
+            tree[parent] = tree[2 * parent + 1] + tree[2 * parent + 2];
+
+            static_ascend(tree, parent, std::integral_constant<std::size_t, Levels - 1>{});
+        }
+    }
+
+
+    /*
+     * Discrete distribution over `[0, N)` where the number of events N is a
+     * compile-time constant. Meant for small N, e.g. choosing among a few
+     * dozen moves in an inner loop.
+     *
+     * The sum tree is stored inline in a built-in array, so the object does
+     * not allocate and can live on the stack. A built-in array rather than
+     * std::array also keeps the const accessors `constexpr` in C++11, where
+     * `std::array::operator[] const` is not. Searches and updates are fully
+     * unrolled for N, and the search is branchless. Construction from a
+     * built-in array is `constexpr`. The tree and the sampled values are
+     * identical to those of `cxx::discrete_distribution` with the same
+     * weights.
+     */
+    template<std::size_t N, typename T = int>
+    class static_discrete_distribution
+    {
+        static_assert(N > 0, "static_discrete_distribution needs at least one event");
+
+        static constexpr std::size_t leaves = detail::static_sumtree_leaves(N);
+        static constexpr std::size_t depth = detail::static_log2(leaves);
+
+    public:
+
+        /*
+         * Type of generated integer.
+         */
+        using result_type = T;
+
+
+        /*
+         * Creates a distribution with all weights zero.
+         */
+        constexpr
+        static_discrete_distribution() noexcept
+            : _tree{}
+        {
+        }
+
+
+        /*
+         * Creates a distribution with given weights.
+         *
+         * Params:
+         *   weights = Weight values. The weights must be non-negative finite
+         *             numbers.
+         *
+         * Time complexity:
+         *   O(N log N). Evaluated at compile time if `weights` is a constant.
+         */
+        constexpr explicit
+        static_discrete_distribution(double const (&weights)[N]) noexcept
+            : static_discrete_distribution{
+                weights, typename detail::make_static_indices<2 * leaves - 1>::type{}
+            }
+        {
+        }
+
+
+        /*
+         * Creates a distribution with given weights.
+         *
+         * Params:
+         *   weights = Weight values. The weights must be non-negative finite
+         *             numbers.
+         *
+         * Time complexity:
+         *   O(N).
+         */
+        explicit
+        static_discrete_distribution(std::array<double, N> const& weights) noexcept
+            : _tree{}
+        {
+            // Build bottom-up. Each node adds the same pair of children as
+            // in the constexpr path, so the tree is bitwise identical.
+            for (std::size_t i = 0; i < N; i++) {
+                _tree[leaves - 1 + i] = weights[i];
+            }
+            for (std::size_t node = leaves - 1; node-- > 0; ) {
+                _tree[node] = _tree[2 * node + 1] + _tree[2 * node + 2];
+            }
+        }
+
+
+        /*
+         * Resets the distribution state. This function does nothing.
+         */
+        void
+        reset()
+        {
+        }
+
+
+        /*
+         * Returns the number of events.
+         */
+        static constexpr std::size_t
+        size() noexcept
+        {
+            return N;
+        }
+
+
+        /*
+         * Returns the minimum possible integer generated from this
+         * distribution, namely, zero.
+         */
+        constexpr result_type
+        min() const noexcept
+        {
+            return 0;
+        }
+
+
+        /*
+         * Returns the maximum possible integer generated from this
+         * distribution.
+         */
+        constexpr result_type
+        max() const noexcept
+        {
+            return result_type(N - 1);
+        }
+
+
+        /*
+         * Returns the sum of the weights.
+         *
+         * Time complexity:
+         *   O(1).
+         */
+        constexpr double
+        sum() const noexcept
+        {
+            return _tree[0];
+        }
+
+
+        /*
+         * Returns the weight of the i-th event.
+         */
+        constexpr double
+        operator[](std::size_t i) const noexcept
+        {
+            return _tree[leaves - 1 + i];
+        }
+
+
+        /*
+         * Returns a pointer to the array containing weight values.
+         */
+        double const*
+        data() const noexcept
+        {
+            return _tree + leaves - 1;
+        }
+
+
+        /*
+         * Updates the weight of the i-th event.
+         *
+         * Params:
+         *   i      = Index of the event. Must be less than N.
+         *   weight = New weight. Must be non-negative finite number.
+         *
+         * Time complexity:
+         *   O(log N), unrolled.
+         */
+        void
+        update(std::size_t i, double weight) noexcept
+        {
+            DISTR_ASSERT(i < N);
+            DISTR_ASSERT(weight >= 0);
+
+            auto const node = leaves - 1 + i;
+            _tree[node] = weight;
+            detail::static_ascend(
+                _tree, node, std::integral_constant<std::size_t, depth>{}
+            );
+        }
+
+
+        /*
+         * Finds the event whose cumulative weight interval covers given probe
+         * value. See `discrete_weights::find`.
+         *
+         * Time complexity:
+         *   O(log N), unrolled and branchless.
+         */
+        std::size_t
+        find(double probe) const noexcept
+        {
+            std::size_t node = 0;
+            detail::static_descend(
+                _tree, node, probe, std::integral_constant<std::size_t, depth>{}
+            );
+
+            auto const index = node - (leaves - 1);
+
+            // Search may overshoot due to numerical errors.
+            return index < N ? index : N - 1;
+        }
+
+
+        /*
+         * Generates a random integer from the distribution.
+         *
+         * Time complexity:
+         *   O(log N), unrolled and branchless.
+         */
+        template<typename RNG>
+        result_type
+        operator()(RNG& random) const
+        {
+            std::uniform_real_distribution<double> uniform{0.0, sum()};
+            return result_type(find(uniform(random)));
+        }
+
+
+    private:
+
+        template<std::size_t... I>
+        constexpr
+        static_discrete_distribution(
+            double const* weights,
+            detail::static_indices<I...>
+        ) noexcept
+            : _tree{detail::static_node_sum(weights, N, leaves, I)...}
+        {
+        }
+
+
+    private:
+        double _tree[2 * leaves - 1];
+    };
+
+
+    template<std::size_t N, typename T>
+    constexpr std::size_t static_discrete_distribution<N, T>::leaves;
+
+    template<std::size_t N, typename T>
+    constexpr std::size_t static_discrete_distribution<N, T>::depth;
+
+
+    template<std::size_t N, typename T>
+    inline bool
+    operator==(
+        cxx::static_discrete_distribution<N, T> const& d1,
+        cxx::static_discrete_distribution<N, T> const& d2
+    )
+    {
+        for (std::size_t i = 0; i < N; i++) {
+            if (d1[i] != d2[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    template<std::size_t N, typename T>
+    inline bool
+    operator!=(
+        cxx::static_discrete_distribution<N, T> const& d1,
+        cxx::static_discrete_distribution<N, T> const& d2
+    )
+    {
+        return !(d1 == d2);
+    }
+}
+
+#undef DISTR_ASSERT
+
+#endif
@@ -0,0 +1,141 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+#include <adaptive_discrete_distribution.hpp>
+
+
+namespace
+{
+    // Returns the histogram of samples scaled to the sum of the weights.
+    std::vector<double>
+    sample_histogram(
+        cxx::adaptive_discrete_distribution<std::size_t>& distr,
+        int sample_count,
+        std::mt19937_64& random
+    )
+    {
+        std::vector<double> histogram(distr.size());
+        double const sample_weight = distr.sum() / double(sample_count);
+
+        for (int sample = 0; sample < sample_count; sample++) {
+            histogram[distr(random)] += sample_weight;
+        }
+        return histogram;
+    }
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - is default constructible")
+{
+    cxx::adaptive_discrete_distribution<int> distr;
+    CHECK(distr.size() == 0);
+    CHECK_FALSE(distr.has_alias_table());
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - is constructible from weights")
+{
+    cxx::adaptive_discrete_distribution<int> distr = {1.0, 2.0, 3.0};
+
+    CHECK(distr.size() == 3);
+    CHECK(distr.min() == 0);
+    CHECK(distr.max() == 2);
+    CHECK(distr.sum() == 6.0);
+    CHECK(distr.weights()[1] == 2.0);
+    CHECK(distr.threshold() == cxx::adaptive_discrete_distribution<int>::default_threshold(3));
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - builds alias table after quiet samples")
+{
+    cxx::adaptive_discrete_distribution<int> distr{{1.0, 2.0, 3.0}, 10};
+    std::mt19937_64 random;
+
+    for (int i = 0; i < 10; i++) {
+        distr(random);
+    }
+    CHECK_FALSE(distr.has_alias_table());
+
+    distr(random);
+    CHECK(distr.has_alias_table());
+
+    // An update drops the table and restarts counting.
+    distr.update(0, 4.0);
+    CHECK_FALSE(distr.has_alias_table());
+
+    for (int i = 0; i < 10; i++) {
+        distr(random);
+    }
+    CHECK_FALSE(distr.has_alias_table());
+
+    distr(random);
+    CHECK(distr.has_alias_table());
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - does not build table for zero weights")
+{
+    cxx::adaptive_discrete_distribution<int> distr{{0.0, 0.0}, 0};
+    std::mt19937_64 random;
+
+    distr(random);
+    CHECK_FALSE(distr.has_alias_table());
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - generates values in correct probability")
+{
+    std::vector<double> weights = {1.0, 0.0, 2.0, 3.0, 4.0};
+    cxx::adaptive_discrete_distribution<std::size_t> distr{weights, 100};
+    std::mt19937_64 random;
+
+    // Mostly from the alias table.
+    auto histogram = sample_histogram(distr, 10000, random);
+    REQUIRE(distr.has_alias_table());
+
+    for (std::size_t i = 0; i < weights.size(); i++) {
+        CHECK(histogram[i] == Approx(weights[i]).epsilon(0.1));
+    }
+    CHECK(histogram[1] == 0);
+
+    // The table reflects updates.
+    distr.update(1, 5.0);
+    distr.update(4, 0.0);
+    weights[1] = 5.0;
+    weights[4] = 0.0;
+
+    histogram = sample_histogram(distr, 10000, random);
+    REQUIRE(distr.has_alias_table());
+
+    for (std::size_t i = 0; i < weights.size(); i++) {
+        CHECK(histogram[i] == Approx(weights[i]).epsilon(0.1));
+    }
+    CHECK(histogram[4] == 0);
+}
+
+
+TEST_CASE("adaptive_discrete_distribution - never samples zero-weight events")
+{
+    // Many events with weights whose scaled cutoffs are not exact.
+    std::size_t const n = 1000;
+    std::vector<double> weights(n);
+    for (std::size_t i = 0; i < n; i++) {
+        weights[i] = i % 3 == 0 ? 0.0 : 0.1 * double(i % 7 + 1);
+    }
+
+    cxx::adaptive_discrete_distribution<std::size_t> distr{weights, 0};
+    std::mt19937_64 random;
+
+    for (int sample = 0; sample < 100000; sample++) {
+        auto const i = distr(random);
+        REQUIRE(weights[i] > 0);
+    }
+    CHECK(distr.has_alias_table());
+}
@@ -0,0 +1,134 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <atomic>
+#include <cstddef>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <atomic_discrete_weights.hpp>
+
+
+TEST_CASE("atomic_discrete_weights - holds given weights")
+{
+    std::vector<double> const weights = {1.0, 0.0, 2.0, 3.0, 4.5};
+    cxx::discrete_weights const expect{weights};
+    cxx::atomic_discrete_weights const atomic{weights};
+
+    REQUIRE(atomic.size() == expect.size());
+    CHECK(atomic.resolution() == cxx::atomic_discrete_weights::default_resolution());
+    CHECK(atomic.sum() == expect.sum());
+    CHECK(atomic.snapshot() == expect);
+
+    for (std::size_t i = 0; i < expect.size(); i++) {
+        CHECK(atomic[i] == expect[i]);
+    }
+
+    for (double probe = 0; probe < expect.sum(); probe += 0.25) {
+        CHECK(atomic.find(probe) == expect.find(probe));
+    }
+    CHECK(atomic.find(1e100) == 4);
+}
+
+
+TEST_CASE("atomic_discrete_weights - rounds weights to resolution")
+{
+    cxx::atomic_discrete_weights atomic{{0.3, 1.0}, 0.25};
+
+    CHECK(atomic.resolution() == 0.25);
+    CHECK(atomic[0] == 0.25);
+    CHECK(atomic[1] == 1.0);
+    CHECK(atomic.sum() == 1.25);
+
+    atomic.update(0, 0.4);
+    CHECK(atomic[0] == 0.5);
+    CHECK(atomic.sum() == 1.5);
+}
+
+
+TEST_CASE("atomic_discrete_weights - single thread updates match discrete_weights")
+{
+    std::size_t const n = 37;
+    std::vector<double> init(n, 1.0);
+    cxx::discrete_weights expect{init};
+    cxx::atomic_discrete_weights atomic{init};
+
+    std::mt19937_64 random;
+    std::uniform_int_distribution<std::size_t> event{0, n - 1};
+    std::uniform_int_distribution<int> weight{0, 16};
+
+    for (int i = 0; i < 1000; i++) {
+        auto const e = event(random);
+        auto const w = weight(random) / 4.0;
+        expect.update(e, w);
+        atomic.update(e, w);
+    }
+
+    CHECK(atomic.sum() == expect.sum());
+    CHECK(atomic.snapshot() == expect);
+}
+
+
+TEST_CASE("atomic_discrete_weights - converges under concurrent updates")
+{
+    // Threads first update all events concurrently, then each thread sets
+    // its own share of events to final values while the others do the same.
+    // A sampler runs throughout. After all threads finish, the tree must be
+    // exact.
+    std::size_t const n = 1000;
+    std::size_t const threads = 4;
+    cxx::atomic_discrete_weights atomic{std::vector<double>(n, 1.0)};
+
+    std::vector<double> finals(n);
+    std::atomic<std::size_t> arrived{0};
+    std::vector<std::thread> writers;
+
+    for (std::size_t t = 0; t < threads; t++) {
+        writers.emplace_back([&, t] {
+            std::mt19937_64 random{t};
+            std::uniform_int_distribution<int> weight{0, 64};
+
+            for (int round = 0; round < 20; round++) {
+                for (std::size_t i = 0; i < n; i++) {
+                    atomic.update(i, weight(random) / 8.0);
+                }
+            }
+
+            arrived++;
+            while (arrived < threads) {
+                std::this_thread::yield();
+            }
+
+            for (std::size_t i = t; i < n; i += threads) {
+                finals[i] = weight(random) / 8.0;
+                atomic.update(i, finals[i]);
+            }
+        });
+    }
+
+    std::size_t out_of_range = 0;
+    std::thread sampler{[&] {
+        std::mt19937_64 random;
+        for (int i = 0; i < 100000; i++) {
+            out_of_range += (atomic(random) >= n);
+        }
+    }};
+
+    for (auto& thread : writers) {
+        thread.join();
+    }
+    sampler.join();
+
+    CHECK(out_of_range == 0);
+
+    cxx::discrete_weights const expect{finals};
+    CHECK(atomic.sum() == expect.sum());
+    CHECK(atomic.snapshot() == expect);
+
+    for (double probe = 0; probe < expect.sum(); probe += 0.5) {
+        CHECK(atomic.find(probe) == expect.find(probe));
+    }
+}
@@ -0,0 +1,162 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <atomic>
+#include <cstddef>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <concurrent_discrete_distribution.hpp>
+
+
+TEST_CASE("concurrent_discrete_distribution - holds given weights")
+{
+    cxx::discrete_weights const origin = {1.0, 0.0, 2.0, 3.0, 4.0};
+    cxx::concurrent_discrete_distribution<int> const distr{origin};
+
+    REQUIRE(distr.size() == origin.size());
+    CHECK(distr.min() == 0);
+    CHECK(distr.max() == 4);
+    CHECK(distr.sum() == origin.sum());
+    CHECK(distr.snapshot() == origin);
+
+    for (std::size_t i = 0; i < origin.size(); i++) {
+        CHECK(distr[i] == origin[i]);
+    }
+
+    for (double probe = 0; probe < origin.sum(); probe += 0.5) {
+        CHECK(distr.find(probe) == origin.find(probe));
+    }
+}
+
+
+TEST_CASE("concurrent_discrete_distribution - samples like discrete_distribution")
+{
+    std::vector<double> const weights = {1.0, 0.0, 2.0, 3.0, 4.0, 0.5};
+    cxx::discrete_distribution<int> serial{weights};
+    cxx::concurrent_discrete_distribution<int> concurrent{weights};
+
+    std::mt19937_64 serial_random;
+    std::mt19937_64 concurrent_random;
+
+    for (int i = 0; i < 1000; i++) {
+        CHECK(concurrent(concurrent_random) == serial(serial_random));
+
+        auto const event = i % int(weights.size());
+        auto const weight = double(i % 7);
+        serial.update(event, weight);
+        concurrent.update(std::size_t(event), weight);
+    }
+
+    CHECK(concurrent.snapshot() == serial.param());
+}
+
+
+TEST_CASE("concurrent_discrete_distribution - updates bump version")
+{
+    cxx::concurrent_discrete_distribution<int> distr{{1.0, 2.0, 3.0}};
+
+    auto const version = distr.version();
+    CHECK(version % 2 == 0);
+
+    distr.update(1, 5.0);
+    CHECK(distr.version() == version + 2);
+    CHECK(distr.sum() == 9.0);
+
+    distr.update({0, 2}, {0.0, 7.0});
+    CHECK(distr.version() == version + 4);
+    CHECK(distr.sum() == 12.0);
+    CHECK(distr[0] == 0.0);
+    CHECK(distr[2] == 7.0);
+}
+
+
+TEST_CASE("concurrent_discrete_distribution - readers never see torn updates")
+{
+    // The writer moves a unit weight around while keeping the total at 2.
+    // Every consistent view has exactly two unit weights and the sum 2.
+    std::size_t const n = 1000;
+    std::vector<double> init(n, 0.0);
+    init[0] = 1.0;
+    init[1] = 1.0;
+
+    cxx::concurrent_discrete_distribution<std::size_t> distr{init};
+    std::atomic<int> running{0};
+    std::atomic<bool> done{false};
+
+    // Checks are made outside the threads since the test framework is not
+    // thread-safe.
+    auto reader = [&](std::size_t seed) {
+        std::mt19937_64 random{seed};
+        int errors = 0;
+        int interleaves = 0;
+        auto last_version = distr.version();
+
+        while (interleaves < 100 && errors == 0) {
+            auto const version = distr.version();
+            if (version != last_version) {
+                interleaves++;
+                last_version = version;
+            }
+
+            if (distr.sum() != 2.0) {
+                errors++;
+            }
+
+            auto const snapshot = distr.snapshot();
+            std::size_t units = 0;
+            for (auto const w : snapshot) {
+                units += (w == 1.0);
+            }
+            if (units != 2 || snapshot.sum() != 2.0) {
+                errors++;
+            }
+
+            for (int i = 0; i < 100; i++) {
+                if (distr(random) >= n) {
+                    errors++;
+                }
+            }
+        }
+        return errors;
+    };
+
+    std::vector<int> errors(3);
+    std::vector<std::thread> readers;
+    for (std::size_t i = 0; i < errors.size(); i++) {
+        running++;
+        readers.emplace_back([&, i] {
+            errors[i] = reader(i);
+            running--;
+        });
+    }
+
+    std::thread writer{[&] {
+        std::size_t stay = 0;
+        std::size_t move = 1;
+
+        while (running > 0) {
+            auto const next = (move + 1) % n;
+            if (next == stay) {
+                std::swap(stay, move);
+                continue;
+            }
+            distr.update({move, next}, {0.0, 1.0});
+            move = next;
+        }
+        done = true;
+    }};
+
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    writer.join();
+
+    CHECK(done);
+    for (auto const e : errors) {
+        CHECK(e == 0);
+    }
+}
@@ -0,0 +1,151 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+#include <csr_graph.hpp>
+
+
+namespace
+{
+    std::vector<std::size_t>
+    to_vector(cxx::csr_graph::range range)
+    {
+        return std::vector<std::size_t>{range.begin(), range.end()};
+    }
+}
+
+
+TEST_CASE("csr_graph - is default constructible")
+{
+    cxx::csr_graph graph;
+
+    CHECK(graph.nodes() == 0);
+    CHECK(graph.edges() == 0);
+}
+
+
+TEST_CASE("csr_graph_builder - builds graph from counted edges")
+{
+    std::vector<std::pair<std::size_t, std::size_t>> const edges = {
+        {2, 0}, {0, 1}, {2, 3}, {0, 2}, {2, 1}
+    };
+
+    cxx::csr_graph_builder builder{4};
+    for (auto const& edge : edges) {
+        builder.count(edge.first);
+    }
+    for (auto const& edge : edges) {
+        builder.insert(edge.first, edge.second);
+    }
+    auto const graph = builder.finish();
+
+    CHECK(graph.nodes() == 4);
+    CHECK(graph.edges() == 5);
+
+    // Targets keep insertion order.
+    CHECK(to_vector(graph.neighbors(0)) == std::vector<std::size_t>{1, 2});
+    CHECK(to_vector(graph.neighbors(1)).empty());
+    CHECK(to_vector(graph.neighbors(2)) == std::vector<std::size_t>{0, 3, 1});
+    CHECK(to_vector(graph.neighbors(3)).empty());
+
+    CHECK(graph.neighbors(2).size() == 3);
+
+    // Raw arrays.
+    std::vector<std::size_t> const offsets{graph.offsets(), graph.offsets() + 5};
+    CHECK(offsets == std::vector<std::size_t>{0, 2, 2, 5, 5});
+}
+
+
+TEST_CASE("csr_graph_builder - accepts bulk counts")
+{
+    cxx::csr_graph_builder builder{2};
+    builder.count(1, 3);
+    builder.insert(1, 0);
+    builder.insert(1, 1);
+    builder.insert(1, 0);
+    auto const graph = builder.finish();
+
+    CHECK(to_vector(graph.neighbors(0)).empty());
+    CHECK(to_vector(graph.neighbors(1)) == std::vector<std::size_t>{0, 1, 0});
+}
+
+
+TEST_CASE("reverse_cuthill_mckee - returns a permutation")
+{
+    // Two components: triangle 0-2-4 and edge 1-3, plus isolated node 5.
+    std::vector<std::pair<std::size_t, std::size_t>> const edges = {
+        {0, 2}, {2, 4}, {4, 0}, {1, 3}
+    };
+
+    cxx::csr_graph_builder builder{6};
+    for (auto const& edge : edges) {
+        builder.count(edge.first);
+        builder.count(edge.second);
+    }
+    for (auto const& edge : edges) {
+        builder.insert(edge.first, edge.second);
+        builder.insert(edge.second, edge.first);
+    }
+    auto const order = cxx::reverse_cuthill_mckee(builder.finish());
+
+    REQUIRE(order.size() == 6);
+
+    auto sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(sorted == std::vector<std::size_t>{0, 1, 2, 3, 4, 5});
+
+    // Each component occupies consecutive positions.
+    auto const position = cxx::invert_permutation(order);
+    auto const span = [&](std::vector<std::size_t> const& nodes) {
+        std::size_t lo = order.size();
+        std::size_t hi = 0;
+        for (auto const node : nodes) {
+            lo = std::min(lo, position[node]);
+            hi = std::max(hi, position[node]);
+        }
+        return hi - lo + 1;
+    };
+    CHECK(span({0, 2, 4}) == 3);
+    CHECK(span({1, 3}) == 2);
+}
+
+
+TEST_CASE("reverse_cuthill_mckee - recovers path of shuffled graph")
+{
+    // Path 0-1-2-...-9 relabeled by a fixed shuffle.
+    std::vector<std::size_t> const label = {7, 2, 9, 0, 5, 3, 8, 1, 6, 4};
+
+    cxx::csr_graph_builder builder{10};
+    for (std::size_t i = 0; i + 1 < label.size(); i++) {
+        builder.count(label[i]);
+        builder.count(label[i + 1]);
+    }
+    for (std::size_t i = 0; i + 1 < label.size(); i++) {
+        builder.insert(label[i], label[i + 1]);
+        builder.insert(label[i + 1], label[i]);
+    }
+    auto const order = cxx::reverse_cuthill_mckee(builder.finish());
+    auto const position = cxx::invert_permutation(order);
+
+    // Adjacent nodes in the path get adjacent positions (bandwidth 1).
+    for (std::size_t i = 0; i + 1 < label.size(); i++) {
+        auto const a = position[label[i]];
+        auto const b = position[label[i + 1]];
+        CHECK((a > b ? a - b : b - a) == 1);
+    }
+}
+
+
+TEST_CASE("invert_permutation - inverts permutation")
+{
+    std::vector<std::size_t> const order = {2, 0, 3, 1};
+    auto const inverse = cxx::invert_permutation(order);
+
+    CHECK(inverse == std::vector<std::size_t>{1, 3, 0, 2});
+}
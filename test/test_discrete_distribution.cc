@@ -2,11 +2,13 @@
 // Distributed under the Boost Software License, Version 1.0. (See accompanying
 // file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
+#include <cstddef>
 #include <initializer_list>
 #include <numeric>
 #include <random>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <catch.hpp>
@@ -185,3 +187,258 @@ TEST_CASE("discrete_distribution - changes distribution on the fly")
     CHECK(distr(random) == 1);
     CHECK(distr(random) == 1);
 }
+
+
+namespace
+{
+    // Allocator counting the number of live allocations.
+    template<typename T>
+    struct counting_allocator
+    {
+        using value_type = T;
+
+        int* live;
+
+        explicit counting_allocator(int* live_)
+            : live{live_}
+        {
+        }
+
+        template<typename U>
+        counting_allocator(counting_allocator<U> const& other)
+            : live{other.live}
+        {
+        }
+
+        T*
+        allocate(std::size_t n)
+        {
+            ++*live;
+            return std::allocator<T>{}.allocate(n);
+        }
+
+        void
+        deallocate(T* p, std::size_t n)
+        {
+            --*live;
+            std::allocator<T>{}.deallocate(p, n);
+        }
+
+        template<typename U>
+        bool
+        operator==(counting_allocator<U> const& other) const
+        {
+            return live == other.live;
+        }
+
+        template<typename U>
+        bool
+        operator!=(counting_allocator<U> const& other) const
+        {
+            return live != other.live;
+        }
+    };
+}
+
+
+TEST_CASE("discrete_distribution - uses given allocator")
+{
+    using allocator_type = counting_allocator<double>;
+    using weights_type = cxx::basic_discrete_weights<cxx::vector_storage<allocator_type>>;
+    using distribution_type = cxx::discrete_distribution<int, weights_type>;
+    int live = 0;
+
+    static_assert(
+        std::is_same<distribution_type::allocator_type, allocator_type>::value,
+        "allocator is taken from the sum tree backend"
+    );
+
+    {
+        allocator_type const alloc{&live};
+        distribution_type distr{{1.0, 2.0, 3.0}, alloc};
+
+        CHECK(live == 1);
+        CHECK(distr.get_allocator() == alloc);
+        CHECK(distr.sum() == Approx(6.0));
+
+        std::mt19937_64 random;
+        for (int i = 0; i < 100; i++) {
+            auto const x = distr(random);
+            CHECK(x >= 0);
+            CHECK(x <= 2);
+        }
+
+        // Text roundtrip preserves the allocator.
+        distribution_type copy{alloc};
+        std::stringstream ss;
+        ss << distr;
+        ss >> copy;
+
+        CHECK(copy == distr);
+        CHECK(copy.get_allocator() == alloc);
+        CHECK(live == 2);
+    }
+
+    CHECK(live == 0);
+}
+
+
+TEST_CASE("discrete_weights - uses given allocator")
+{
+    using allocator_type = counting_allocator<double>;
+    using weights_type = cxx::basic_discrete_weights<cxx::vector_storage<allocator_type>>;
+    int live = 0;
+
+    {
+        allocator_type const alloc{&live};
+        weights_type weights{cxx::vector_storage<allocator_type>{alloc}, {1.0, 2.0}};
+
+        CHECK(live == 1);
+        CHECK(weights == cxx::discrete_weights{1.0, 2.0});
+
+        // Binary roundtrip preserves the allocator.
+        std::stringstream ss;
+        cxx::write_binary(ss, weights);
+
+        weights_type loaded{cxx::vector_storage<allocator_type>{alloc}, 0, 0};
+        REQUIRE(cxx::read_binary(ss, loaded));
+
+        CHECK(loaded == weights);
+        CHECK(loaded.storage().get_allocator() == alloc);
+        CHECK(live == 2);
+    }
+
+    CHECK(live == 0);
+}
+
+
+namespace
+{
+    // Minimal backend holding weights in a flat array, searched linearly.
+    class linear_weights
+    {
+    public:
+        linear_weights() = default;
+
+        explicit
+        linear_weights(std::vector<double> const& weights)
+            : _weights{weights}
+        {
+        }
+
+        std::size_t
+        size() const
+        {
+            return _weights.size();
+        }
+
+        double
+        sum() const
+        {
+            return std::accumulate(_weights.begin(), _weights.end(), 0.0);
+        }
+
+        void
+        update(std::size_t i, double weight)
+        {
+            _weights[i] = weight;
+        }
+
+        std::size_t
+        find(double probe) const
+        {
+            std::size_t i = 0;
+            for (; i + 1 < _weights.size(); i++) {
+                if (probe < _weights[i]) {
+                    break;
+                }
+                probe -= _weights[i];
+            }
+            return i;
+        }
+
+    private:
+        std::vector<double> _weights;
+    };
+}
+
+
+TEST_CASE("discrete_distribution - accepts custom backend")
+{
+    using distribution_type = cxx::discrete_distribution<int, linear_weights>;
+
+    static_assert(
+        std::is_same<distribution_type::weights_type, linear_weights>::value,
+        "backend is used as the weights"
+    );
+
+    // Integer weights make the results exactly the same as the sum tree.
+    distribution_type distr = {1.0, 0.0, 2.0, 3.0};
+    cxx::discrete_distribution<int> reference = {1.0, 0.0, 2.0, 3.0};
+
+    CHECK(distr.min() == 0);
+    CHECK(distr.max() == 3);
+    CHECK(distr.sum() == 6.0);
+
+    std::mt19937_64 random;
+    std::mt19937_64 reference_random;
+
+    for (int i = 0; i < 1000; i++) {
+        if (i % 10 == 0) {
+            auto const event = i / 10 % 4;
+            auto const weight = double(i / 10 % 3);
+            distr.update(event, weight);
+            reference.update(event, weight);
+        }
+        REQUIRE(distr(random) == reference(reference_random));
+    }
+
+    // Copyable through the parameter.
+    distribution_type copy{distr.param()};
+    CHECK(copy.sum() == distr.sum());
+}
+
+
+TEST_CASE("discrete_distribution - uses discrete_weights as default backend")
+{
+    using distribution_type = cxx::discrete_distribution<int, cxx::discrete_weights>;
+
+    static_assert(
+        std::is_same<distribution_type, cxx::discrete_distribution<int>>::value,
+        "default backend is discrete_weights"
+    );
+    static_assert(
+        std::is_same<distribution_type::allocator_type, std::allocator<double>>::value,
+        "default backend has the default allocator"
+    );
+
+    distribution_type distr = {1.0, 2.0, 3.0};
+    distribution_type copy;
+
+    std::stringstream ss;
+    ss << distr;
+    ss >> copy;
+
+    CHECK(copy == distr);
+    CHECK(distr.param().sum() == 6.0);
+}
+
+
+#if __cplusplus >= 201703L && defined(__cpp_lib_memory_resource)
+
+TEST_CASE("pmr::discrete_distribution - allocates from memory resource")
+{
+    alignas(double) char arena[1024];
+    std::pmr::monotonic_buffer_resource resource{arena, sizeof arena};
+
+    cxx::pmr::discrete_distribution<int> distr{{1.0, 2.0, 3.0}, &resource};
+
+    auto const tree = distr.param().storage().data();
+    auto const address = reinterpret_cast<char const*>(tree);
+
+    CHECK(address >= arena);
+    CHECK(address < arena + sizeof arena);
+    CHECK(distr.sum() == Approx(6.0));
+}
+
+#endif
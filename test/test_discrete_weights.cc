@@ -3,10 +3,21 @@
 // file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 #include <algorithm>
+#include <clocale>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <initializer_list>
+#include <limits>
 #include <numeric>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <streambuf>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <catch.hpp>
 #include <discrete_distribution.hpp>
@@ -141,6 +152,18 @@ TEST_CASE("discrete_weights::update - updates weight value")
 }
 
 
+TEST_CASE("discrete_weights::update - works with single event")
+{
+    cxx::discrete_weights weights = {1.0};
+
+    weights.update(0, 2.5);
+
+    CHECK(weights[0] == 2.5);
+    CHECK(weights.sum() == 2.5);
+    CHECK(weights.find(1.0) == 0);
+}
+
+
 TEST_CASE("discrete_weights::find - finds the correct event")
 {
     // 0.0  1.0  2.0  3.0  4.0  5.0  6.0
@@ -179,6 +202,18 @@ TEST_CASE("discrete_weights::find - returns edge event for overshoot probe")
 }
 
 
+TEST_CASE("discrete_weights::find - does not touch memory of empty object")
+{
+    cxx::discrete_weights weights;
+
+    CHECK(weights.find(0.0) == std::size_t(-1));
+    CHECK(weights.find(1.0) == std::size_t(-1));
+
+    cxx::discrete_weights_view view;
+    CHECK(view.find(0.0) == std::size_t(-1));
+}
+
+
 TEST_CASE("discrete_weights::find - finds the correct event after weight update")
 {
     // 0.0  1.0  2.0  3.0  4.0  5.0  6.0
@@ -250,3 +285,498 @@ TEST_CASE("discrete_weights - is serializable")
         CHECK(roundtrip[i] == Approx(origin[i]));
     }
 }
+
+
+TEST_CASE("discrete_weights - is binary serializable")
+{
+    cxx::discrete_weights origin = {1.2, 3.4, 5.6, 0.0, 7.8};
+    origin.update(3, 0.1);
+
+    std::stringstream ss;
+    write_binary(ss, origin);
+
+    cxx::discrete_weights roundtrip;
+    REQUIRE(read_binary(ss, roundtrip));
+
+    // Binary roundtrip is exact, including internal sums.
+    CHECK(roundtrip == origin);
+    CHECK(roundtrip.sum() == origin.sum());
+
+    for (double probe = 0; probe < origin.sum(); probe += 0.5) {
+        CHECK(roundtrip.find(probe) == origin.find(probe));
+    }
+}
+
+
+TEST_CASE("discrete_weights - binary roundtrip works for empty weights")
+{
+    cxx::discrete_weights const origin;
+
+    std::stringstream ss;
+    cxx::write_binary(ss, origin);
+
+    cxx::discrete_weights roundtrip = {1.0, 2.0};
+    REQUIRE(cxx::read_binary(ss, roundtrip));
+
+    CHECK(roundtrip.size() == 0);
+}
+
+
+namespace
+{
+    // Stream buffer over a string that does not support seeking, like a
+    // pipe.
+    class unseekable_buf : public std::streambuf
+    {
+    public:
+        explicit
+        unseekable_buf(std::string data)
+            : _data{std::move(data)}
+        {
+            setg(&_data[0], &_data[0], &_data[0] + _data.size());
+        }
+
+    private:
+        std::string _data;
+    };
+}
+
+
+TEST_CASE("discrete_weights - binary deserialization detects bad input")
+{
+    cxx::discrete_weights const origin = {1.0, 2.0, 3.0};
+    std::stringstream ss;
+    cxx::write_binary(ss, origin);
+    auto const data = ss.str();
+
+    cxx::discrete_weights const initial = {4.0};
+
+    SECTION("bad magic")
+    {
+        auto corrupt = data;
+        corrupt[0] = 'X';
+
+        std::istringstream is{corrupt};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+
+    SECTION("bad version")
+    {
+        auto corrupt = data;
+        corrupt[12] = char(corrupt[12] + 1);
+        corrupt[15] = char(corrupt[15] + 1);
+
+        std::istringstream is{corrupt};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+
+    SECTION("truncated data")
+    {
+        std::istringstream is{data.substr(0, data.size() - 1)};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+
+    SECTION("leaves not a power of two")
+    {
+        auto corrupt = data;
+        auto const leaves = std::uint64_t(6);
+        std::memcpy(&corrupt[32], &leaves, sizeof leaves);
+
+        std::istringstream is{corrupt};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+
+    // A header declaring a tree far larger than memory must fail without
+    // attempting to allocate it, or by catching the allocation failure.
+    auto huge = data;
+    auto const huge_leaves = std::uint64_t(1) << 55;
+    std::memcpy(&huge[32], &huge_leaves, sizeof huge_leaves);
+
+    SECTION("huge leaves in seekable stream")
+    {
+        std::istringstream is{huge};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+
+    SECTION("huge leaves in unseekable stream")
+    {
+        unseekable_buf buf{huge};
+        std::istream is{&buf};
+        cxx::discrete_weights weights = initial;
+        CHECK_FALSE(cxx::read_binary(is, weights));
+        CHECK(weights == initial);
+    }
+}
+
+
+TEST_CASE("discrete_weights - binary deserialization handles byte order")
+{
+    cxx::discrete_weights const origin = {1.0, 2.0, 3.0};
+    std::stringstream ss;
+    cxx::write_binary(ss, origin);
+    auto data = ss.str();
+
+    // Emulate a file written on a machine of the opposite byte order.
+    auto const reverse = [&](std::size_t offset, std::size_t size) {
+        std::reverse(data.begin() + long(offset), data.begin() + long(offset + size));
+    };
+    for (std::size_t offset = 8; offset < 24; offset += 4) {
+        reverse(offset, 4);
+    }
+    for (std::size_t offset = 24; offset < data.size(); offset += 8) {
+        reverse(offset, 8);
+    }
+    // Reserved bytes are zero, so reversing them is harmless.
+
+    std::istringstream is{data};
+    cxx::discrete_weights weights;
+    REQUIRE(cxx::read_binary(is, weights));
+    CHECK(weights == origin);
+    CHECK(weights.sum() == origin.sum());
+}
+
+
+TEST_CASE("discrete_weights - text roundtrip is exact")
+{
+    std::vector<double> const values = {
+        0.1, 1.0 / 3.0, 2.0 / 3.0, 1e-300, 1.7976931348623157e308, 0.0, 123456.789
+    };
+    cxx::discrete_weights const origin{values};
+
+    // Stream precision does not matter.
+    std::ostringstream os;
+    os.precision(3);
+    os << origin;
+
+    cxx::discrete_weights roundtrip;
+    std::istringstream is{os.str()};
+    REQUIRE(is >> roundtrip);
+
+    REQUIRE(roundtrip.size() == values.size());
+    for (std::size_t i = 0; i < values.size(); i++) {
+        CHECK(roundtrip[i] == values[i]);
+    }
+    CHECK(roundtrip.sum() == origin.sum());
+}
+
+
+TEST_CASE("discrete_weights - text output uses shortest form")
+{
+    cxx::discrete_weights const weights = {0.5, 0.1, 2.0};
+
+    std::ostringstream os;
+    os << weights;
+
+    CHECK(os.str() == "3 0.5 0.1 2");
+}
+
+
+TEST_CASE("discrete_weights - shortest formatting works without charconv")
+{
+    // The fallback formatter used before C++17 matches std::to_chars on
+    // these values.
+    std::pair<double, char const*> const cases[] = {
+        {0.0, "0"},
+        {0.1, "0.1"},
+        {0.001, "0.001"},
+        {1.5e-7, "1.5e-07"},
+        {100.0, "100"},
+        {123456.789, "123456.789"},
+        {1e22, "1e+22"},
+        {1e23, "9.999999999999999e+22"},
+        {5e-324, "5e-324"},
+        {2.2250738585072014e-308, "2.2250738585072014e-308"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+    };
+
+    char buffer[cxx::detail::text_format::format_capacity + 1];
+
+    for (auto const& test : cases) {
+        auto const length = cxx::detail::text_format::format_shortest(buffer, test.first);
+        CHECK(std::string(buffer, length) == test.second);
+    }
+
+    // Any double reads back exactly.
+    std::mt19937_64 random;
+
+    for (int i = 0; i < 100000; i++) {
+        auto const bits = random() >> 1;
+        double value;
+        std::memcpy(&value, &bits, sizeof value);
+        if (!(value <= std::numeric_limits<double>::max())) {
+            continue;
+        }
+
+        auto const length = cxx::detail::text_format::format_shortest(buffer, value);
+        REQUIRE(length <= cxx::detail::text_format::format_capacity);
+        buffer[length] = '\0';
+        REQUIRE(std::strtod(buffer, nullptr) == value);
+    }
+}
+
+
+TEST_CASE("discrete_weights - text deserialization accepts long tokens")
+{
+    std::string const zeros(100, '0');
+    std::istringstream is{zeros + "2 " + zeros + "1.5 2.5" + zeros};
+
+    cxx::discrete_weights weights;
+    REQUIRE(is >> weights);
+    CHECK(weights.size() == 2);
+    CHECK(weights[0] == 1.5);
+    CHECK(weights[1] == 2.5);
+}
+
+
+TEST_CASE("discrete_weights - text format does not depend on the C locale")
+{
+    // Skipped if no locale with a decimal comma is installed.
+    char const* const names[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"};
+    std::string const saved = std::setlocale(LC_ALL, nullptr);
+
+    for (auto const name : names) {
+        if (!std::setlocale(LC_ALL, name)) {
+            continue;
+        }
+
+        cxx::discrete_weights const origin = {0.5, 1.25};
+        std::ostringstream os;
+        os << origin;
+
+        cxx::discrete_weights roundtrip;
+        std::istringstream is{os.str()};
+        is >> roundtrip;
+
+        std::setlocale(LC_ALL, saved.c_str());
+
+        CHECK(os.str() == "2 0.5 1.25");
+        CHECK(roundtrip == origin);
+        break;
+    }
+
+    std::setlocale(LC_ALL, saved.c_str());
+}
+
+
+TEST_CASE("discrete_weights - text deserialization stops after the weights")
+{
+    std::istringstream is{"  2\n1.5\t+2.5e1 rest"};
+
+    cxx::discrete_weights weights;
+    REQUIRE(is >> weights);
+    CHECK(weights.size() == 2);
+    CHECK(weights[0] == 1.5);
+    CHECK(weights[1] == 25.0);
+
+    std::string rest;
+    is >> rest;
+    CHECK(rest == "rest");
+}
+
+
+TEST_CASE("discrete_weights - text deserialization detects bad input")
+{
+    cxx::discrete_weights const initial = {4.0};
+
+    char const* const inputs[] = {
+        "",
+        "x",
+        "-1 1.0",
+        "2 1.0",
+        "2 1.0 abc",
+        "2 1.0 2.0x",
+        "18446744073709551615 1",
+        "9223372036854775809 1",
+        "4611686018427387905 1",
+    };
+
+    for (auto const input : inputs) {
+        std::istringstream is{input};
+        cxx::discrete_weights weights = initial;
+
+        CHECK_FALSE(is >> weights);
+        CHECK(weights == initial);
+    }
+}
+
+
+TEST_CASE("discrete_weights - supports wide character streams")
+{
+    cxx::discrete_weights const origin = {1.25, 0.0, 3.5};
+
+    std::wostringstream os;
+    os << origin;
+    CHECK(os.str() == L"3 1.25 0 3.5");
+
+    cxx::discrete_weights roundtrip;
+    std::wistringstream is{os.str()};
+    REQUIRE(is >> roundtrip);
+    CHECK(roundtrip == origin);
+}
+
+
+TEST_CASE("required_storage - returns the size of the sum tree")
+{
+    CHECK(cxx::required_storage(0) == 1);
+    CHECK(cxx::required_storage(1) == 1);
+    CHECK(cxx::required_storage(2) == 3);
+    CHECK(cxx::required_storage(3) == 7);
+    CHECK(cxx::required_storage(4) == 7);
+    CHECK(cxx::required_storage(5) == 15);
+
+    auto const max = std::numeric_limits<std::size_t>::max();
+    CHECK(cxx::required_storage(max / 2 + 1) == max);
+    CHECK_THROWS_AS(cxx::required_storage(max / 2 + 2), std::length_error);
+    CHECK_THROWS_AS(cxx::required_storage(max), std::length_error);
+}
+
+
+TEST_CASE("discrete_weights_view - builds tree in given buffer")
+{
+    std::vector<double> const values = {1.0, 0.0, 2.0, 3.0, 4.0};
+    cxx::discrete_weights const expected{values};
+
+    std::vector<double> buffer(cxx::required_storage(values.size()), -1.0);
+    cxx::discrete_weights_view view{
+        cxx::span_storage{buffer.data(), buffer.size()}, values
+    };
+
+    CHECK(view.storage().data() == buffer.data());
+    CHECK(view == expected);
+    CHECK(view.sum() == expected.sum());
+    CHECK(buffer[0] == expected.sum());
+
+    for (double probe = 0; probe < expected.sum(); probe += 0.25) {
+        CHECK(view.find(probe) == expected.find(probe));
+    }
+}
+
+
+TEST_CASE("discrete_weights_view - updates the buffer in place")
+{
+    std::vector<double> buffer(cxx::required_storage(3));
+    cxx::discrete_weights_view view{
+        cxx::span_storage{buffer.data(), buffer.size()}, {1.0, 2.0, 3.0}
+    };
+
+    // Copies refer to the same buffer.
+    auto const alias = view;
+
+    view.update(1, 5.0);
+
+    CHECK(view.sum() == 9.0);
+    CHECK(alias.sum() == 9.0);
+    CHECK(alias[1] == 5.0);
+    CHECK(buffer[0] == 9.0);
+}
+
+
+TEST_CASE("discrete_weights_view - can adopt existing tree")
+{
+    cxx::discrete_weights weights = {1.0, 2.0, 3.0};
+    auto& storage = weights.storage();
+
+    cxx::discrete_weights_view view{
+        cxx::span_storage{storage.data(), storage.size()},
+        weights.size(),
+        weights.leaves()
+    };
+
+    CHECK(view == weights);
+
+    view.update(0, 4.0);
+    CHECK(weights[0] == 4.0);
+    CHECK(weights.sum() == 9.0);
+}
+
+
+TEST_CASE("discrete_weights::refresh - recomputes sums from the weights")
+{
+    cxx::discrete_weights weights = {1.0, 2.0, 3.0, 4.0, 5.0};
+
+    auto const tree = weights.storage().data();
+    auto const leaves = tree + weights.leaves() - 1;
+    leaves[0] = 6.0;
+    leaves[4] = 1.0;
+
+    CHECK(weights.sum() == 15.0);
+
+    weights.refresh();
+
+    CHECK(weights.sum() == 16.0);
+    CHECK(weights.find(5.5) == 0);
+    CHECK(weights.find(15.5) == 4);
+}
+
+
+TEST_CASE("discrete_weights::update - does not accumulate rounding errors")
+{
+    // Updates recompute sums from children, so the tree after many updates
+    // is exactly the tree rebuilt from the same weights.
+    std::size_t const n = 1000;
+    std::mt19937_64 random;
+    std::uniform_int_distribution<std::size_t> event{0, n - 1};
+    std::uniform_real_distribution<double> weight{0.0, 1.0};
+
+    std::vector<double> init(n);
+    for (auto& w : init) {
+        w = weight(random);
+    }
+    cxx::discrete_weights weights{init};
+
+    for (int k = 0; k < 100000; k++) {
+        // Zero out some events to check that no residue remains.
+        weights.update(event(random), k % 3 == 0 ? 0.0 : weight(random) * 1e6);
+    }
+
+    cxx::discrete_weights rebuilt{std::vector<double>(weights.begin(), weights.end())};
+
+    auto const tree_size = 2 * weights.leaves() - 1;
+    CHECK(std::equal(
+        weights.storage().data(),
+        weights.storage().data() + tree_size,
+        rebuilt.storage().data()
+    ));
+}
+
+
+TEST_CASE("discrete_weights::find - agrees with cumulative sums for small and large trees")
+{
+    // Small trees are searched without branches and large trees with
+    // branches. Both must find the event by the definition.
+    std::size_t const n = GENERATE(
+        std::size_t(100), cxx::detail::branchless_leaves + std::size_t(1)
+    );
+    std::mt19937_64 random;
+    std::uniform_int_distribution<int> weight{0, 3};
+
+    // Integer weights make the cumulative sums exact.
+    std::vector<double> weights(n);
+    for (auto& w : weights) {
+        w = weight(random);
+    }
+    weights.back() = 1;
+
+    cxx::discrete_weights tree{weights};
+    std::vector<double> cumsum(n + 1);
+    std::partial_sum(weights.begin(), weights.end(), cumsum.begin() + 1);
+
+    std::uniform_real_distribution<double> probe{0, tree.sum()};
+    for (int k = 0; k < 1000; k++) {
+        auto const p = k % 2 == 0 ? probe(random) : double(k % int(tree.sum()));
+        auto const expect = std::size_t(
+            std::upper_bound(cumsum.begin() + 1, cumsum.end(), p) - (cumsum.begin() + 1)
+        );
+        REQUIRE(tree.find(p) == expect);
+    }
+}
@@ -0,0 +1,167 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This file is compiled into a separate test program with DISTR_STATS
+// defined, since the macro changes the layout of discrete_weights.
+
+#ifndef DISTR_STATS
+#  error "DISTR_STATS must be defined"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <discrete_distribution.hpp>
+
+
+TEST_CASE("latency_histogram - buckets latencies by powers of two")
+{
+    cxx::latency_histogram histogram;
+
+    CHECK(histogram.total() == 0);
+    CHECK(histogram.quantile(0.5) == 0);
+    CHECK(histogram.mean() == 0);
+
+    histogram.record(0);
+    histogram.record(1);
+    histogram.record(2);
+    histogram.record(3);
+    histogram.record(100);
+    histogram.record(std::uint64_t(1) << 60);
+
+    CHECK(histogram.count(0) == 2);
+    CHECK(histogram.count(1) == 2);
+    CHECK(histogram.count(6) == 1);
+    CHECK(histogram.count(std::size_t(cxx::latency_histogram::buckets) - 1) == 1);
+    CHECK(histogram.total() == 6);
+
+    CHECK(histogram.quantile(0.0) == 2);
+    CHECK(histogram.quantile(0.5) == 4);
+    CHECK(histogram.quantile(0.8) == 128);
+}
+
+
+TEST_CASE("latency_histogram - computes mean latency")
+{
+    cxx::latency_histogram histogram;
+
+    histogram.record(10);
+    histogram.record(20);
+    histogram.record(60);
+
+    CHECK(histogram.mean() == 30.0);
+}
+
+
+TEST_CASE("discrete_weights - counts operations with DISTR_STATS")
+{
+    cxx::discrete_weights weights = {1.0, 2.0, 3.0, 4.0, 5.0};
+    auto const& stats = weights.stats();
+
+    // Five events occupy eight leaves, so the tree has three levels.
+    CHECK(stats.rebuilds == 1);
+    CHECK(stats.updates == 0);
+    CHECK(stats.finds == 0);
+
+    weights.update(1, 0.5);
+    weights.update(4, 1.5);
+
+    CHECK(stats.updates == 2);
+    CHECK(stats.update_levels == 6);
+    CHECK(stats.update_latency.total() == 1);
+
+    weights.find(0.0);
+    weights.find(1.0);
+    weights.find(100.0);
+
+    CHECK(stats.finds == 3);
+    CHECK(stats.find_levels == 9);
+    CHECK(stats.find_clamps == 1);
+    CHECK(stats.find_latency.total() == 1);
+
+    weights.reset_stats();
+    CHECK(stats.updates == 0);
+    CHECK(stats.finds == 0);
+    CHECK(stats.find_latency.total() == 0);
+}
+
+
+TEST_CASE("discrete_distribution - samples are counted as finds")
+{
+    cxx::discrete_distribution<int> distr{1.0, 2.0, 3.0};
+    std::mt19937_64 random;
+
+    for (int i = 0; i < 100; i++) {
+        distr(random);
+    }
+    distr.update(0, 4.0);
+
+    auto const& stats = distr.param().stats();
+    CHECK(stats.finds == 100);
+    CHECK(stats.updates == 1);
+}
+
+
+TEST_CASE("discrete_weights - times one call per latency period")
+{
+    cxx::discrete_weights weights = {1.0, 2.0, 3.0};
+    auto const& stats = weights.stats();
+    auto const period = cxx::detail::latency_period;
+
+    for (std::uint64_t i = 0; i < 3 * period; i++) {
+        weights.find(1.0);
+        weights.update(0, 1.0);
+    }
+    CHECK(stats.finds == 3 * period);
+    CHECK(stats.find_latency.total() == 3);
+    CHECK(stats.updates == 3 * period);
+    CHECK(stats.update_latency.total() == 3);
+
+    weights.find(1.0);
+    CHECK(stats.find_latency.total() == 4);
+}
+
+
+TEST_CASE("discrete_weights - text input counts a rebuild")
+{
+    cxx::discrete_weights const source = {1.0, 2.0, 3.0};
+    std::stringstream stream;
+    stream << source;
+
+    cxx::discrete_weights weights;
+    weights.reset_stats();
+    stream >> weights;
+
+    CHECK(weights == source);
+    CHECK(weights.stats().rebuilds == 1);
+}
+
+
+TEST_CASE("discrete_weights - concurrent finds are counted without races")
+{
+    cxx::discrete_weights const weights = {1.0, 2.0, 3.0, 4.0};
+    int const threads = 4;
+    int const finds = 1000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < finds; i++) {
+                weights.find(double(i % 10));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Concurrent increments may be lost, but never invented.
+    CHECK(weights.stats().finds >= std::uint64_t(finds));
+    CHECK(weights.stats().finds <= std::uint64_t(threads * finds));
+}
@@ -0,0 +1,142 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+#include <catch.hpp>
+#include <mapped_discrete_weights.hpp>
+
+
+namespace
+{
+    // Temporary file removed on scope exit.
+    class temporary_file
+    {
+    public:
+        temporary_file()
+        {
+            char name[] = "/tmp/cxx_distr_test_XXXXXX";
+            int const fd = ::mkstemp(name);
+            REQUIRE(fd != -1);
+            ::close(fd);
+            _path = name;
+        }
+
+        ~temporary_file()
+        {
+            std::remove(_path.c_str());
+        }
+
+        std::string const&
+        path() const
+        {
+            return _path;
+        }
+
+    private:
+        std::string _path;
+    };
+
+
+    void
+    save(std::string const& path, cxx::discrete_weights const& weights)
+    {
+        std::ofstream file{path, std::ios::binary};
+        cxx::write_binary(file, weights);
+        REQUIRE(file);
+    }
+}
+
+
+TEST_CASE("map_discrete_weights - maps weights saved in binary")
+{
+    cxx::discrete_weights const origin = {1.0, 0.0, 2.0, 3.0, 4.0};
+    temporary_file file;
+    save(file.path(), origin);
+
+    auto const mapped = cxx::map_discrete_weights(file.path());
+
+    CHECK(mapped == origin);
+    CHECK(mapped.size() == origin.size());
+    CHECK(mapped.sum() == origin.sum());
+    CHECK_FALSE(mapped.storage().writable());
+
+    for (double probe = 0; probe < origin.sum(); probe += 0.25) {
+        CHECK(mapped.find(probe) == origin.find(probe));
+    }
+}
+
+
+TEST_CASE("map_discrete_weights - writes updates back to file")
+{
+    cxx::discrete_weights origin = {1.0, 2.0, 3.0};
+    temporary_file file;
+    save(file.path(), origin);
+
+    {
+        auto mapped = cxx::map_discrete_weights(file.path(), cxx::map_mode::read_write);
+        REQUIRE(mapped.storage().writable());
+
+        mapped.update(1, 5.0);
+        CHECK(mapped.sum() == 1.0 + 5.0 + 3.0);
+        mapped.storage().sync();
+    }
+
+    origin.update(1, 5.0);
+
+    cxx::discrete_weights reloaded;
+    std::ifstream stream{file.path(), std::ios::binary};
+    REQUIRE(cxx::read_binary(stream, reloaded));
+
+    CHECK(reloaded == origin);
+    CHECK(reloaded.sum() == origin.sum());
+}
+
+
+TEST_CASE("map_discrete_weights - is movable")
+{
+    cxx::discrete_weights const origin = {1.0, 2.0};
+    temporary_file file;
+    save(file.path(), origin);
+
+    auto mapped = cxx::map_discrete_weights(file.path());
+    auto moved = std::move(mapped);
+
+    CHECK(moved == origin);
+    CHECK(mapped.storage().data() == nullptr);
+}
+
+
+TEST_CASE("map_discrete_weights - rejects invalid file")
+{
+    temporary_file file;
+
+    SECTION("missing file")
+    {
+        CHECK_THROWS_AS(
+            cxx::map_discrete_weights(file.path() + ".missing"),
+            std::system_error
+        );
+    }
+
+    SECTION("empty file")
+    {
+        CHECK_THROWS_AS(cxx::map_discrete_weights(file.path()), std::runtime_error);
+    }
+
+    SECTION("text file")
+    {
+        std::ofstream stream{file.path()};
+        stream << cxx::discrete_weights{1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0};
+        stream.close();
+
+        CHECK_THROWS_AS(cxx::map_discrete_weights(file.path()), std::runtime_error);
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+#include <vector>
+
+#include <catch.hpp>
+#include <discrete_distribution.hpp>
+#include <parallel_sample.hpp>
+
+
+TEST_CASE("sample_parallel - gives identical samples regardless of threads")
+{
+    std::vector<double> weights(1000);
+    for (std::size_t i = 0; i < weights.size(); i++) {
+        weights[i] = double(i % 7);
+    }
+    cxx::discrete_distribution<int> const distr{weights};
+
+    std::size_t const n = 20000;
+    std::vector<int> serial(n);
+    cxx::sample_parallel(distr, 42, 1000, n, serial.begin());
+
+    for (unsigned threads = 1; threads <= 4; threads++) {
+        std::vector<int> parallel(n);
+        cxx::sample_parallel(distr, 42, 1000, n, parallel.data(), cxx::thread_executor{threads});
+        CHECK(parallel == serial);
+    }
+
+    for (auto const event : serial) {
+        CHECK(weights[std::size_t(event)] > 0);
+    }
+}
+
+
+TEST_CASE("sample_parallel - uses counter j for sample j")
+{
+    cxx::discrete_distribution<int> const distr{1.0, 2.0, 3.0, 4.0};
+
+    std::vector<int> full(100);
+    cxx::sample_parallel(distr, 7, 0, full.size(), full.begin());
+
+    // A batch starting at counter 60 reproduces the tail of the full batch.
+    std::vector<int> tail(40);
+    cxx::sample_parallel(distr, 7, 60, tail.size(), tail.begin());
+    CHECK(std::vector<int>(full.begin() + 60, full.end()) == tail);
+
+    // Sample j equals a draw from a fresh engine at stream j.
+    for (std::size_t j = 0; j < full.size(); j++) {
+        cxx::philox4x32 engine{7, j};
+        CHECK(distr(engine) == full[j]);
+    }
+
+    // Different keys give different samples.
+    std::vector<int> other(100);
+    cxx::sample_parallel(distr, 8, 0, other.size(), other.begin());
+    CHECK(other != full);
+}
@@ -0,0 +1,162 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+#include <parallel_update.hpp>
+
+
+namespace
+{
+    // Executor running tasks in reverse order on the calling thread. Used
+    // to check that results do not depend on the order of tasks.
+    struct reverse_executor
+    {
+        template<typename Task>
+        void
+        operator()(std::size_t tasks, Task task) const
+        {
+            for (std::size_t t = tasks; t-- > 0; ) {
+                task(t);
+            }
+        }
+    };
+
+
+    bool
+    same_tree(cxx::discrete_weights const& w1, cxx::discrete_weights const& w2)
+    {
+        auto const tree_size = 2 * w1.leaves() - 1;
+        return w1.leaves() == w2.leaves() && std::equal(
+            w1.storage().data(), w1.storage().data() + tree_size, w2.storage().data()
+        );
+    }
+}
+
+
+TEST_CASE("thread_executor - runs every task once")
+{
+    cxx::thread_executor const executor{4};
+    CHECK(executor.threads() == 4);
+
+    std::vector<int> counts(1000);
+    executor(counts.size(), [&](std::size_t t) {
+        counts[t]++;
+    });
+
+    CHECK(std::count(counts.begin(), counts.end(), 1) == 1000);
+}
+
+
+TEST_CASE("parallel_update - gives the same tree as serial updates")
+{
+    std::size_t const n = 100000;
+    std::mt19937_64 random;
+    std::uniform_real_distribution<double> weight{0.0, 1.0};
+
+    std::vector<double> init(n);
+    for (auto& w : init) {
+        w = weight(random);
+    }
+
+    // Random indices with duplicates. Sorting is optional.
+    bool const sorted = GENERATE(false, true);
+
+    std::vector<std::size_t> indices(50000);
+    std::vector<double> values(indices.size());
+    std::uniform_int_distribution<std::size_t> event{0, n - 1};
+
+    for (std::size_t k = 0; k < indices.size(); k++) {
+        indices[k] = event(random);
+        values[k] = weight(random);
+    }
+    if (sorted) {
+        std::sort(indices.begin(), indices.end());
+    }
+
+    cxx::discrete_weights expect{init};
+    for (std::size_t k = 0; k < indices.size(); k++) {
+        expect.update(indices[k], values[k]);
+    }
+
+    SECTION("thread_executor")
+    {
+        cxx::discrete_weights actual{init};
+        cxx::parallel_update(actual, indices, values, cxx::thread_executor{4});
+        CHECK(same_tree(actual, expect));
+    }
+
+    SECTION("reverse_executor")
+    {
+        cxx::discrete_weights actual{init};
+        cxx::parallel_update(actual, indices, values, reverse_executor{});
+        CHECK(same_tree(actual, expect));
+    }
+}
+
+
+TEST_CASE("parallel_update - last value wins for duplicate indices")
+{
+    cxx::discrete_weights weights = {1.0, 2.0, 3.0};
+
+    cxx::parallel_update(weights, {2, 0, 2, 1, 2}, {5.0, 0.0, 6.0, 4.0, 7.0}, reverse_executor{});
+
+    CHECK(weights[0] == 0.0);
+    CHECK(weights[1] == 4.0);
+    CHECK(weights[2] == 7.0);
+    CHECK(weights.sum() == 11.0);
+}
+
+
+TEST_CASE("parallel_update - handles trivial cases")
+{
+    cxx::discrete_weights single = {1.0};
+    cxx::parallel_update(single, {0}, {3.0}, cxx::thread_executor{2});
+    CHECK(single[0] == 3.0);
+    CHECK(single.sum() == 3.0);
+
+    cxx::discrete_weights weights = {1.0, 2.0};
+    cxx::parallel_update(weights, {}, {}, cxx::thread_executor{2});
+    CHECK(weights.sum() == 3.0);
+}
+
+
+TEST_CASE("parallel_refresh - gives the same tree as serial refresh")
+{
+    std::size_t const n = GENERATE(std::size_t(1), std::size_t(1000), std::size_t(100000));
+    std::mt19937_64 random;
+    std::uniform_real_distribution<double> weight{0.0, 1.0};
+
+    std::vector<double> init(n);
+    for (auto& w : init) {
+        w = weight(random);
+    }
+
+    cxx::discrete_weights expect{init};
+    cxx::discrete_weights actual{init};
+
+    // Overwrite the weights directly so that the sums need refreshing.
+    auto const expect_leaves = expect.storage().data() + expect.leaves() - 1;
+    auto const actual_leaves = actual.storage().data() + actual.leaves() - 1;
+    for (std::size_t i = 0; i < n; i++) {
+        expect_leaves[i] = actual_leaves[i] = weight(random);
+    }
+    expect.refresh();
+
+    SECTION("thread_executor")
+    {
+        cxx::parallel_refresh(actual, cxx::thread_executor{4});
+        CHECK(same_tree(actual, expect));
+    }
+
+    SECTION("reverse_executor")
+    {
+        cxx::parallel_refresh(actual, reverse_executor{});
+        CHECK(same_tree(actual, expect));
+    }
+}
@@ -0,0 +1,137 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdint>
+#include <random>
+
+#include <catch.hpp>
+#include <philox.hpp>
+
+
+TEST_CASE("philox4x32 - matches known answers")
+{
+    // Known-answer vectors of Philox4x32-10 from Random123.
+    struct known_answer
+    {
+        std::uint32_t counter[4];
+        std::uint32_t key[2];
+        std::uint32_t output[4];
+    };
+
+    known_answer const cases[] = {
+        {
+            {0x00000000, 0x00000000, 0x00000000, 0x00000000},
+            {0x00000000, 0x00000000},
+            {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}
+        },
+        {
+            {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+            {0xffffffff, 0xffffffff},
+            {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}
+        },
+        {
+            {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+            {0xa4093822, 0x299f31d0},
+            {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}
+        },
+    };
+
+    for (auto const& known : cases) {
+        std::uint32_t block[4] = {
+            known.counter[0], known.counter[1], known.counter[2], known.counter[3]
+        };
+        cxx::philox4x32::block(block, known.key);
+
+        CHECK(block[0] == known.output[0]);
+        CHECK(block[1] == known.output[1]);
+        CHECK(block[2] == known.output[2]);
+        CHECK(block[3] == known.output[3]);
+    }
+}
+
+
+TEST_CASE("philox4x32 - generates blocks in counter order")
+{
+    std::uint64_t const key = 0x299f31d0a4093822;
+    std::uint64_t const stream = 0x0370734413198a2e;
+    cxx::philox4x32 engine{key, stream};
+
+    CHECK(engine.key() == key);
+    CHECK(engine.stream() == stream);
+
+    std::uint32_t const key_words[2] = {0xa4093822, 0x299f31d0};
+
+    for (std::uint32_t block_index = 0; block_index < 3; block_index++) {
+        std::uint32_t block[4] = {block_index, 0, 0x13198a2e, 0x03707344};
+        cxx::philox4x32::block(block, key_words);
+
+        for (auto const expect : block) {
+            CHECK(engine() == expect);
+        }
+    }
+}
+
+
+TEST_CASE("philox4x32 - satisfies UniformRandomBitGenerator")
+{
+    using engine_type = cxx::philox4x32;
+
+    CHECK(engine_type::min() == 0);
+    CHECK(engine_type::max() == 0xffffffff);
+
+    engine_type engine;
+    std::uniform_real_distribution<double> uniform;
+
+    for (int i = 0; i < 100; i++) {
+        auto const u = uniform(engine);
+        CHECK(u >= 0);
+        CHECK(u < 1);
+    }
+}
+
+
+TEST_CASE("philox4x32 - discards outputs")
+{
+    for (unsigned long long skip = 0; skip < 20; skip++) {
+        for (int pre = 0; pre < 5; pre++) {
+            cxx::philox4x32 expect{1, 2};
+            cxx::philox4x32 actual{1, 2};
+
+            for (int i = 0; i < pre; i++) {
+                expect();
+                actual();
+            }
+            for (unsigned long long i = 0; i < skip; i++) {
+                expect();
+            }
+            actual.discard(skip);
+
+            CHECK(actual == expect);
+            CHECK(actual() == expect());
+        }
+    }
+}
+
+
+TEST_CASE("philox4x32 - compares state")
+{
+    cxx::philox4x32 e1{1, 2};
+    cxx::philox4x32 e2{1, 2};
+    cxx::philox4x32 e3{1, 3};
+
+    CHECK(e1 == e2);
+    CHECK(e1 != e3);
+
+    e1();
+    CHECK(e1 != e2);
+
+    e2();
+    CHECK(e1 == e2);
+
+    for (int i = 0; i < 3; i++) {
+        e1();
+    }
+    e2.discard(3);
+    CHECK(e1 == e2);
+}
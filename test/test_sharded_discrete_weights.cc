@@ -0,0 +1,144 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <sharded_discrete_weights.hpp>
+
+
+TEST_CASE("sharded_discrete_weights - splits events into shards")
+{
+    std::vector<double> const weights = {1.0, 0.0, 2.0, 3.0, 4.0, 0.5, 1.5};
+    cxx::sharded_discrete_weights const sharded{weights, 3};
+
+    CHECK(sharded.size() == 7);
+    CHECK(sharded.shards() == 3);
+    CHECK(sharded.shard_begin(0) == 0);
+    CHECK(sharded.shard_begin(1) == 2);
+    CHECK(sharded.shard_begin(2) == 4);
+    CHECK(sharded.shard_begin(3) == 7);
+
+    CHECK(sharded.shard_of(0) == 0);
+    CHECK(sharded.shard_of(1) == 0);
+    CHECK(sharded.shard_of(2) == 1);
+    CHECK(sharded.shard_of(3) == 1);
+    CHECK(sharded.shard_of(4) == 2);
+    CHECK(sharded.shard_of(6) == 2);
+
+    CHECK(sharded.shard_sum(0) == 1.0);
+    CHECK(sharded.shard_sum(1) == 5.0);
+    CHECK(sharded.shard_sum(2) == 6.0);
+    CHECK(sharded.sum() == 12.0);
+
+    for (std::size_t i = 0; i < weights.size(); i++) {
+        CHECK(sharded[i] == weights[i]);
+    }
+}
+
+
+TEST_CASE("sharded_discrete_weights - finds same events as discrete_weights")
+{
+    std::vector<double> weights = {1.0, 0.0, 2.0, 3.0, 4.0, 0.5, 1.5, 0.0, 2.0};
+    cxx::discrete_weights expect{weights};
+    cxx::sharded_discrete_weights sharded{weights, 4};
+
+    for (double probe = 0; probe < expect.sum(); probe += 0.25) {
+        CHECK(sharded.find(probe) == expect.find(probe));
+    }
+
+    expect.update(4, 0.0);
+    expect.update(8, 3.0);
+    sharded.update(4, 0.0);
+    sharded.update(8, 3.0);
+
+    CHECK(sharded.sum() == expect.sum());
+    for (double probe = 0; probe < expect.sum(); probe += 0.25) {
+        CHECK(sharded.find(probe) == expect.find(probe));
+    }
+}
+
+
+TEST_CASE("sharded_discrete_weights - samples with a single probe over the total")
+{
+    std::vector<double> const weights = {1.0, 0.0, 2.0, 3.0, 4.0, 0.5, 1.5, 0.0, 2.0};
+    cxx::sharded_discrete_weights const sharded{weights, 3};
+
+    std::mt19937_64 random;
+    std::mt19937_64 reference;
+
+    for (int i = 0; i < 1000; i++) {
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+        auto const expect = sharded.find(uniform(reference) * sharded.sum());
+        REQUIRE(sharded(random) == expect);
+    }
+
+    // Exactly one number is drawn per sample.
+    CHECK(random == reference);
+}
+
+
+TEST_CASE("sharded_discrete_weights - allows more shards than events")
+{
+    cxx::sharded_discrete_weights sharded{{1.0, 2.0}, 5};
+
+    CHECK(sharded.shards() == 5);
+    CHECK(sharded.sum() == 3.0);
+    CHECK(sharded.find(0.5) == 0);
+    CHECK(sharded.find(1.5) == 1);
+    CHECK(sharded.find(10.0) == 1);
+
+    std::mt19937_64 random;
+    for (int i = 0; i < 100; i++) {
+        CHECK(sharded(random) < 2);
+    }
+}
+
+
+TEST_CASE("sharded_discrete_weights - threads update own shards concurrently")
+{
+    std::size_t const n = 1000;
+    std::size_t const threads = 4;
+    cxx::sharded_discrete_weights sharded{std::vector<double>(n, 1.0), threads};
+
+    std::vector<double> finals(n);
+    std::vector<std::size_t> out_of_range(threads);
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 random{t};
+            std::uniform_int_distribution<int> weight{0, 64};
+
+            auto const begin = sharded.shard_begin(t);
+            auto const end = sharded.shard_begin(t + 1);
+
+            for (int round = 0; round < 20; round++) {
+                for (auto i = begin; i < end; i++) {
+                    finals[i] = weight(random) / 8.0;
+                    sharded.update_shard(t, i, finals[i]);
+                    out_of_range[t] += (sharded(random) >= n);
+                }
+            }
+        });
+    }
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    for (auto const count : out_of_range) {
+        CHECK(count == 0);
+    }
+
+    cxx::discrete_weights const expect{finals};
+    CHECK(sharded.sum() == expect.sum());
+
+    for (std::size_t i = 0; i < n; i++) {
+        CHECK(sharded[i] == finals[i]);
+    }
+}
@@ -0,0 +1,272 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+#include <shared_discrete_weights.hpp>
+
+
+namespace
+{
+    // Shared memory segment name unlinked on scope exit.
+    class temporary_segment
+    {
+    public:
+        temporary_segment()
+            : _name{"/cxx_distr_test_" + std::to_string(::getpid())}
+        {
+            cxx::shared_discrete_weights::unlink(_name);
+        }
+
+        ~temporary_segment()
+        {
+            cxx::shared_discrete_weights::unlink(_name);
+        }
+
+        std::string const&
+        name() const
+        {
+            return _name;
+        }
+
+    private:
+        std::string _name;
+    };
+}
+
+
+TEST_CASE("shared_discrete_weights - creates and opens segment")
+{
+    temporary_segment const segment;
+    cxx::discrete_weights const origin = {1.0, 0.0, 2.0, 3.0, 4.0};
+
+    auto const writer = cxx::shared_discrete_weights::create(segment.name(), origin);
+    auto const reader = cxx::shared_discrete_weights::open(segment.name());
+
+    CHECK(writer.writable());
+    CHECK_FALSE(reader.writable());
+
+    REQUIRE(reader.size() == origin.size());
+    CHECK(reader.sum() == origin.sum());
+    CHECK(reader.snapshot() == origin);
+
+    for (std::size_t i = 0; i < origin.size(); i++) {
+        CHECK(reader[i] == origin[i]);
+    }
+
+    for (double probe = 0; probe < origin.sum(); probe += 0.5) {
+        CHECK(reader.find(probe) == origin.find(probe));
+    }
+}
+
+
+TEST_CASE("shared_discrete_weights - rejects existing or missing segment")
+{
+    temporary_segment const segment;
+    cxx::discrete_weights const origin = {1.0, 2.0};
+
+    CHECK_THROWS_AS(
+        cxx::shared_discrete_weights::open(segment.name()), std::system_error
+    );
+
+    auto const writer = cxx::shared_discrete_weights::create(segment.name(), origin);
+
+    CHECK_THROWS_AS(
+        cxx::shared_discrete_weights::create(segment.name(), origin), std::system_error
+    );
+}
+
+
+TEST_CASE("shared_discrete_weights - rejects unpublished segment")
+{
+    temporary_segment const segment;
+
+    // A zero-filled segment looks like one whose creator has not yet
+    // published the magic.
+    int const fd = ::shm_open(segment.name().c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    REQUIRE(fd != -1);
+    REQUIRE(::ftruncate(fd, 4096) == 0);
+    ::close(fd);
+
+    CHECK_THROWS_AS(
+        cxx::shared_discrete_weights::open(segment.name()), std::runtime_error
+    );
+}
+
+
+TEST_CASE("shared_discrete_weights - reader cannot update")
+{
+    temporary_segment const segment;
+    cxx::discrete_weights const origin = {1.0, 2.0};
+
+    auto const writer = cxx::shared_discrete_weights::create(segment.name(), origin);
+    auto reader = cxx::shared_discrete_weights::open(segment.name());
+
+    CHECK_THROWS_AS(reader.update(0, 5.0), std::logic_error);
+    CHECK_THROWS_AS(reader.update({0, 1}, {5.0, 6.0}), std::logic_error);
+    CHECK(reader.snapshot() == origin);
+}
+
+
+TEST_CASE("shared_discrete_weights - reader detects writer died in update")
+{
+    temporary_segment const segment;
+    cxx::discrete_weights const origin = {1.0, 2.0};
+
+    auto const writer = cxx::shared_discrete_weights::create(segment.name(), origin);
+    auto const reader = cxx::shared_discrete_weights::open(
+        segment.name(), std::chrono::milliseconds{10}
+    );
+
+    // Leave the sequence number odd as a writer killed in an update would.
+    int const fd = ::shm_open(segment.name().c_str(), O_RDWR, 0);
+    REQUIRE(fd != -1);
+    auto const map = ::mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    REQUIRE(map != MAP_FAILED);
+
+    auto const sequence = reinterpret_cast<std::atomic<std::uint64_t>*>(
+        static_cast<char*>(map) + 64
+    );
+    auto const version = sequence->load();
+    sequence->store(version + 1);
+
+    CHECK_THROWS_AS(reader.sum(), std::runtime_error);
+    CHECK_THROWS_AS(reader.snapshot(), std::runtime_error);
+
+    sequence->store(version + 2);
+    CHECK(reader.sum() == origin.sum());
+
+    ::munmap(map, 4096);
+}
+
+
+TEST_CASE("shared_discrete_weights - reader observes updates")
+{
+    temporary_segment const segment;
+    cxx::discrete_weights expect = {1.0, 2.0, 3.0};
+
+    auto writer = cxx::shared_discrete_weights::create(segment.name(), expect);
+    auto const reader = cxx::shared_discrete_weights::open(segment.name());
+
+    auto const version = reader.version();
+    CHECK(version % 2 == 0);
+
+    writer.update(1, 5.0);
+    expect.update(1, 5.0);
+
+    CHECK(reader.version() == version + 2);
+    CHECK(reader[1] == 5.0);
+    CHECK(reader.sum() == 9.0);
+
+    writer.update({0, 2}, {0.0, 7.0});
+    expect.update(0, 0.0);
+    expect.update(2, 7.0);
+
+    CHECK(reader.version() == version + 4);
+    CHECK(reader.snapshot() == expect);
+
+    std::mt19937_64 random;
+    for (int i = 0; i < 100; i++) {
+        CHECK(reader(random) != 0);
+    }
+}
+
+
+TEST_CASE("shared_discrete_weights - readers never see torn updates")
+{
+    temporary_segment const segment;
+
+    // The writer moves a unit weight around while keeping the total at 2.
+    // Every consistent view has exactly two unit weights and the sum 2.
+    std::size_t const n = 1000;
+    std::vector<double> init(n, 0.0);
+    init[0] = 1.0;
+    init[1] = 1.0;
+
+    auto writer = cxx::shared_discrete_weights::create(
+        segment.name(), cxx::discrete_weights{init}
+    );
+
+    pid_t const child = ::fork();
+    REQUIRE(child != -1);
+
+    if (child == 0) {
+        // Reader process. Reports failure through the exit status since
+        // the test framework is not usable here.
+        int status = 0;
+        try {
+            auto const reader = cxx::shared_discrete_weights::open(segment.name());
+            std::mt19937_64 random;
+
+            // Keep reading until the writer has run between reads enough
+            // times. This matters when both processes share a single core.
+            int interleaves = 0;
+            auto last_version = reader.version();
+
+            while (interleaves < 100 && status == 0) {
+                auto const version = reader.version();
+                if (version != last_version) {
+                    interleaves++;
+                    last_version = version;
+                }
+
+                if (reader.sum() != 2.0) {
+                    status = 1;
+                }
+
+                auto const snapshot = reader.snapshot();
+                std::size_t units = 0;
+                for (auto const w : snapshot) {
+                    units += (w == 1.0);
+                }
+                if (units != 2 || snapshot.sum() != 2.0) {
+                    status = 2;
+                }
+
+                for (int i = 0; i < 100; i++) {
+                    auto const event = reader(random);
+                    if (event >= n) {
+                        status = 3;
+                    }
+                }
+            }
+        } catch (...) {
+            status = 4;
+        }
+        ::_exit(status);
+    }
+
+    std::size_t stay = 0;
+    std::size_t move = 1;
+    int status = 0;
+
+    while (::waitpid(child, &status, WNOHANG) == 0) {
+        auto const next = (move + 1) % n;
+        if (next == stay) {
+            std::swap(stay, move);
+            continue;
+        }
+        writer.update({move, next}, {0.0, 1.0});
+        move = next;
+    }
+
+    REQUIRE(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+}
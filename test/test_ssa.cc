@@ -0,0 +1,250 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+#include <ssa.hpp>
+
+
+TEST_CASE("reaction_network::add_reaction - records net changes")
+{
+    // 0 + 1 --> 2 + 1 (1 is a catalyst)
+    cxx::ssa::reaction_network network{3};
+    auto const r = network.add_reaction(1.5, {{0, 1}, {1, 1}}, {{2, 1}, {1, 1}});
+
+    CHECK(r == 0);
+    CHECK(network.species() == 3);
+    CHECK(network.reactions() == 1);
+    CHECK(network.rate(0) == 1.5);
+
+    std::vector<cxx::ssa::species_term> changes;
+    for (auto const& term : network.changes(0)) {
+        changes.push_back(term);
+    }
+
+    REQUIRE(changes.size() == 2);
+    CHECK(changes[0].species == 0);
+    CHECK(changes[0].count == -1);
+    CHECK(changes[1].species == 2);
+    CHECK(changes[1].count == +1);
+}
+
+
+TEST_CASE("reaction_network::propensity - obeys mass action kinetics")
+{
+    cxx::ssa::reaction_network network{2};
+    network.add_reaction(2.0, {}, {{0, 1}});               // 0 --> A
+    network.add_reaction(2.0, {{0, 1}}, {});               // A --> 0
+    network.add_reaction(2.0, {{0, 1}, {1, 1}}, {});       // A + B --> 0
+    network.add_reaction(2.0, {{0, 2}}, {{1, 1}});         // 2A --> B
+
+    std::vector<cxx::ssa::count_type> const counts = {5, 3};
+
+    CHECK(network.propensity(0, counts.data()) == Approx(2.0));
+    CHECK(network.propensity(1, counts.data()) == Approx(2.0 * 5));
+    CHECK(network.propensity(2, counts.data()) == Approx(2.0 * 5 * 3));
+    CHECK(network.propensity(3, counts.data()) == Approx(2.0 * 5 * 4 / 2));
+
+    std::vector<cxx::ssa::count_type> const depleted = {1, 0};
+
+    CHECK(network.propensity(2, depleted.data()) == 0);
+    CHECK(network.propensity(3, depleted.data()) == 0);
+}
+
+
+TEST_CASE("reaction_network::permuted - renumbers reactions")
+{
+    cxx::ssa::reaction_network network{3};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+    network.add_reaction(2.0, {{1, 1}}, {{2, 1}});
+    network.add_reaction(3.0, {{2, 2}}, {{0, 1}});
+
+    auto const permuted = network.permuted({2, 0, 1});
+
+    REQUIRE(permuted.reactions() == 3);
+    CHECK(permuted.rate(0) == 3.0);
+    CHECK(permuted.rate(1) == 1.0);
+    CHECK(permuted.rate(2) == 2.0);
+
+    std::vector<cxx::ssa::count_type> const counts = {4, 5, 6};
+    CHECK(permuted.propensity(0, counts.data()) == network.propensity(2, counts.data()));
+    CHECK(permuted.propensity(1, counts.data()) == network.propensity(0, counts.data()));
+    CHECK(permuted.propensity(2, counts.data()) == network.propensity(1, counts.data()));
+}
+
+
+TEST_CASE("locality_order - groups reactions sharing a reactant")
+{
+    // Reactions consuming species 0 and those consuming species 1 are
+    // interleaved in the original numbering.
+    cxx::ssa::reaction_network network{3};
+    network.add_reaction(1.0, {{0, 1}}, {{2, 1}});
+    network.add_reaction(1.0, {{1, 1}}, {{2, 1}});
+    network.add_reaction(1.0, {{0, 1}}, {{2, 1}});
+    network.add_reaction(1.0, {{1, 1}}, {{2, 1}});
+
+    auto const order = cxx::ssa::locality_order(network);
+    REQUIRE(order.size() == 4);
+
+    auto const reactant = [&](std::size_t k) {
+        return network.reactants(order[k]).begin()->species;
+    };
+    CHECK(reactant(0) == reactant(1));
+    CHECK(reactant(2) == reactant(3));
+    CHECK(reactant(0) != reactant(2));
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine - keeps propensities consistent with counts", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    // Circular conversion 0 --> 1 --> 2 --> 0 with a catalyzed shortcut.
+    cxx::ssa::reaction_network network{3};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+    network.add_reaction(1.0, {{1, 1}}, {{2, 1}});
+    network.add_reaction(1.0, {{2, 1}}, {{0, 1}});
+    network.add_reaction(0.5, {{0, 1}, {2, 1}}, {{1, 1}, {2, 1}});
+
+    TestType engine{network, {10, 0, 0}};
+
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(engine.step());
+
+        auto const& counts = engine.counts();
+        CHECK(counts[0] + counts[1] + counts[2] == 10);
+
+        for (std::size_t r = 0; r < network.reactions(); r++) {
+            CHECK(engine.propensities()[r] == network.propensity(r, counts.data()));
+        }
+    }
+
+    CHECK(engine.steps() == 1000);
+    CHECK(engine.time() > 0);
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine - copies share the network and keep their own state", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    cxx::ssa::reaction_network network{2};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+
+    TestType const engine{network, {3, 0}};
+    TestType copy = engine;
+
+    CHECK(&copy.network() == &engine.network());
+
+    CHECK(copy.run_until(1e6) == 3);
+    CHECK(copy.counts()[0] == 0);
+    CHECK(engine.counts()[0] == 3);
+    CHECK(engine.steps() == 0);
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine::run_until - stops at given time", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    cxx::ssa::reaction_network network{1};
+    network.add_reaction(10.0, {}, {{0, 1}});
+
+    TestType engine{network, {0}};
+
+    std::size_t observed = 0;
+    double last_time = 0;
+
+    auto const fired = engine.run_until(5.0, [&](
+        TestType const& e, std::size_t reaction
+    ) {
+        CHECK(reaction == 0);
+        CHECK(e.time() >= last_time);
+        CHECK(e.time() <= 5.0);
+        last_time = e.time();
+        observed++;
+    });
+
+    CHECK(fired == observed);
+    CHECK(engine.steps() == fired);
+    CHECK(engine.time() == 5.0);
+    CHECK(engine.counts()[0] == cxx::ssa::count_type(fired));
+
+    // Poisson process with mean 50: fired count is well within 50 +/- 35.
+    CHECK(fired > 15);
+    CHECK(fired < 85);
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine::run_until - stops when no reaction can fire", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    cxx::ssa::reaction_network network{2};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+
+    TestType engine{network, {3, 0}};
+
+    CHECK(engine.run_until(1e6) == 3);
+    CHECK(engine.counts()[0] == 0);
+    CHECK(engine.counts()[1] == 3);
+    CHECK(engine.time() == 1e6);
+    CHECK_FALSE(engine.step());
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine::run_until - stops at infinite time when no reaction can fire", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    cxx::ssa::reaction_network network{2};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+    network.add_reaction(0.0, {{1, 1}}, {{0, 1}});
+
+    TestType engine{network, {3, 0}};
+
+    CHECK(engine.run_until(std::numeric_limits<double>::infinity()) == 3);
+    CHECK(engine.steps() == 3);
+    CHECK(engine.counts()[0] == 0);
+    CHECK(engine.counts()[1] == 3);
+    CHECK_FALSE(engine.step());
+}
+
+
+TEMPLATE_TEST_CASE(
+    "engine - reproduces exponential decay", "",
+    cxx::ssa::direct_engine<std::mt19937_64>,
+    cxx::ssa::next_reaction_engine<std::mt19937_64>
+)
+{
+    // A --> B with unit rate. Each molecule survives until t = 1 with
+    // probability p = exp(-1), so the count of A is binomial(1000, p) with
+    // mean 368 and standard deviation 15.
+    cxx::ssa::reaction_network network{2};
+    network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+
+    // A catalyzed reaction driven by B exercises rescaling of waiting times
+    // in the next reaction method without affecting the count of A.
+    network.add_reaction(0.01, {{1, 1}}, {{1, 1}});
+
+    TestType engine{network, {1000, 0}};
+    engine.run_until(1.0);
+
+    CHECK(engine.counts()[0] > 368 - 75);
+    CHECK(engine.counts()[0] < 368 + 75);
+}
@@ -0,0 +1,156 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+#include <ssa_ensemble.hpp>
+
+
+namespace
+{
+    using engine_type = cxx::ssa::direct_engine<std::mt19937_64>;
+
+    engine_type
+    make_decay_engine()
+    {
+        // A --> B with unit rate.
+        cxx::ssa::reaction_network network{2};
+        network.add_reaction(1.0, {{0, 1}}, {{1, 1}});
+        return engine_type{network, {100, 0}};
+    }
+
+    cxx::ssa::count_type
+    run_decay(engine_type& engine, std::size_t)
+    {
+        engine.run_until(1.0);
+        return engine.counts()[0];
+    }
+}
+
+
+TEST_CASE("ensemble_runner - runs every replicate from the initial state")
+{
+    auto const prototype = make_decay_engine();
+    cxx::ssa::ensemble_runner const runner{4};
+
+    // Catch assertions are not thread-safe, so the function reports a
+    // non-initial state by returning an invalid index.
+    std::vector<std::size_t> const indices = runner.run(
+        prototype, 100, 0, [](engine_type& engine, std::size_t index) {
+            auto const initial =
+                engine.time() == 0 &&
+                engine.steps() == 0 &&
+                engine.counts()[0] == 100;
+            engine.run_until(1.0);
+            return initial ? index : std::size_t(-1);
+        }
+    );
+
+    REQUIRE(indices.size() == 100);
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        CHECK(indices[i] == i);
+    }
+
+    // Prototype is not modified.
+    CHECK(prototype.counts()[0] == 100);
+}
+
+
+TEST_CASE("ensemble_runner - result does not depend on thread count")
+{
+    auto const prototype = make_decay_engine();
+
+    auto const serial = cxx::ssa::ensemble_runner{1}.run(prototype, 50, 42, run_decay);
+    auto const parallel = cxx::ssa::ensemble_runner{3}.run(prototype, 50, 42, run_decay);
+    auto const other_seed = cxx::ssa::ensemble_runner{3}.run(prototype, 50, 43, run_decay);
+
+    CHECK(serial == parallel);
+    CHECK(serial != other_seed);
+
+    // Replicates use different random streams.
+    bool all_same = true;
+    for (auto const count : serial) {
+        all_same = all_same && (count == serial[0]);
+    }
+    CHECK_FALSE(all_same);
+}
+
+
+TEST_CASE("ensemble_runner - propagates exceptions")
+{
+    auto const prototype = make_decay_engine();
+    cxx::ssa::ensemble_runner const runner{2};
+
+    CHECK_THROWS_AS(
+        runner.run(prototype, 10, 0, [](engine_type&, std::size_t index) {
+            if (index == 7) {
+                throw std::runtime_error("replicate failed");
+            }
+            return index;
+        }),
+        std::runtime_error
+    );
+}
+
+
+TEST_CASE("ensemble_runner - rethrows the first exception in time")
+{
+    auto const prototype = make_decay_engine();
+    cxx::ssa::ensemble_runner const runner{2};
+    std::atomic<bool> early_thrown{false};
+
+    // Replicate 0 runs on worker 0 and throws only after replicate 1 has
+    // thrown on worker 1.
+    auto const run = [&] {
+        return runner.run(prototype, 2, 0, [&](engine_type&, std::size_t index) {
+            if (index == 1) {
+                early_thrown = true;
+                throw std::runtime_error("early");
+            }
+            while (!early_thrown) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            throw std::logic_error("late");
+            return index;
+        });
+    };
+
+    CHECK_THROWS_AS(run(), std::runtime_error);
+}
+
+
+TEST_CASE("ensemble_runner - rejects too many replicates")
+{
+    auto const prototype = make_decay_engine();
+    cxx::ssa::ensemble_runner const runner{2};
+
+    if (std::numeric_limits<std::size_t>::max() > std::numeric_limits<std::uint32_t>::max()) {
+        auto const replicates = std::size_t(std::numeric_limits<std::uint32_t>::max()) + 1;
+
+        CHECK_THROWS_AS(runner.run(prototype, replicates, 0, run_decay), std::length_error);
+    }
+}
+
+
+TEST_CASE("ensemble_runner - task ranges occupy separate cache lines")
+{
+    std::unique_ptr<char[]> buffer;
+    auto const ranges = cxx::ssa::detail::make_task_ranges(buffer, 3);
+
+    CHECK(sizeof(ranges[0]) >= 64);
+    for (std::size_t w = 0; w < 3; w++) {
+        CHECK(reinterpret_cast<std::uintptr_t>(ranges + w) % 64 == 0);
+    }
+}
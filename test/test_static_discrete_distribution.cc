@@ -0,0 +1,155 @@
+// Copyright snsinfu 2020.
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <array>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+#include <discrete_distribution.hpp>
+#include <static_discrete_distribution.hpp>
+
+
+TEST_CASE("static_discrete_distribution - is constexpr constructible")
+{
+    constexpr cxx::static_discrete_distribution<3> distr{{1.0, 2.0, 3.0}};
+
+    static_assert(distr.size() == 3, "size is a constant");
+    static_assert(distr.max() == 2, "max is a constant");
+    static_assert(distr.sum() == 6.0, "tree is built at compile time");
+    static_assert(distr[1] == 2.0, "weights are constants");
+
+    CHECK(distr.find(0.5) == 0);
+    CHECK(distr.find(1.5) == 1);
+    CHECK(distr.find(3.5) == 2);
+}
+
+
+TEST_CASE("static_discrete_distribution - is default constructible")
+{
+    cxx::static_discrete_distribution<4> distr;
+
+    CHECK(distr.sum() == 0.0);
+    CHECK(distr[3] == 0.0);
+}
+
+
+TEST_CASE("static_discrete_distribution - is constructible from std::array")
+{
+    std::array<double, 5> const weights = {{1.0, 0.0, 2.0, 3.0, 4.0}};
+    cxx::static_discrete_distribution<5> distr{weights};
+
+    CHECK(distr.size() == 5);
+    CHECK(distr.sum() == 10.0);
+    CHECK(distr.data()[4] == 4.0);
+    CHECK(distr.find(0.5) == 0);
+    CHECK(distr.find(1.0) == 2);
+    CHECK(distr.find(9.5) == 4);
+}
+
+
+TEST_CASE("static_discrete_distribution::update - updates weight value")
+{
+    cxx::static_discrete_distribution<4> distr{{1.0, 0.0, 2.0, 3.0}};
+
+    distr.update(1, 2.0);
+    CHECK(distr[1] == 2.0);
+    CHECK(distr.sum() == 8.0);
+    CHECK(distr.find(2.5) == 1);
+
+    distr.update(2, 0.0);
+    CHECK(distr.sum() == 6.0);
+    CHECK(distr.find(4.0) == 3);
+}
+
+
+TEST_CASE("static_discrete_distribution::find - returns edge event for overshoot probe")
+{
+    cxx::static_discrete_distribution<3> distr{{1.0, 2.0, 3.0}};
+
+    CHECK(distr.find(6.0) == 2);
+    CHECK(distr.find(100.0) == 2);
+}
+
+
+TEST_CASE("static_discrete_distribution - works with single event")
+{
+    cxx::static_discrete_distribution<1> distr{{2.0}};
+    std::mt19937 random;
+
+    CHECK(distr.sum() == 2.0);
+    CHECK(distr(random) == 0);
+
+    distr.update(0, 3.0);
+    CHECK(distr.sum() == 3.0);
+}
+
+
+TEST_CASE("static_discrete_distribution - is equality comparable")
+{
+    cxx::static_discrete_distribution<3> distr1{{1.0, 2.0, 3.0}};
+    cxx::static_discrete_distribution<3> distr2{{1.0, 2.0, 3.0}};
+    cxx::static_discrete_distribution<3> distr3{{1.0, 2.0, 4.0}};
+
+    CHECK(distr1 == distr2);
+    CHECK(distr1 != distr3);
+}
+
+
+TEST_CASE("static_discrete_distribution - matches discrete_distribution")
+{
+    constexpr std::size_t n = 37;
+
+    std::mt19937_64 random;
+    std::uniform_real_distribution<double> weight{0.0, 1.0};
+    std::uniform_int_distribution<std::size_t> event{0, n - 1};
+
+    std::array<double, n> init;
+    for (auto& w : init) {
+        w = weight(random);
+    }
+
+    cxx::static_discrete_distribution<n> fixed{init};
+    cxx::discrete_distribution<int> dynamic{std::vector<double>(init.begin(), init.end())};
+
+    REQUIRE(fixed.sum() == dynamic.sum());
+
+    std::mt19937_64 random_fixed;
+    std::mt19937_64 random_dynamic;
+
+    for (int step = 0; step < 1000; step++) {
+        auto const i = event(random);
+        auto const w = weight(random);
+        fixed.update(i, w);
+        dynamic.update(int(i), w);
+
+        REQUIRE(fixed.sum() == dynamic.sum());
+        REQUIRE(fixed(random_fixed) == dynamic(random_dynamic));
+    }
+}
+
+
+TEST_CASE("static_discrete_distribution - builds the same tree from std::array")
+{
+    constexpr std::size_t n = 23;
+
+    std::mt19937_64 random;
+    std::uniform_real_distribution<double> weight{0.0, 1.0};
+
+    std::array<double, n> init;
+    double raw[n];
+    for (std::size_t i = 0; i < n; i++) {
+        raw[i] = init[i] = weight(random);
+    }
+
+    cxx::static_discrete_distribution<n> const from_array{init};
+    cxx::static_discrete_distribution<n> const from_raw{raw};
+
+    CHECK(from_array.sum() == from_raw.sum());
+
+    for (double probe = 0; probe < from_raw.sum(); probe += 0.01) {
+        REQUIRE(from_array.find(probe) == from_raw.find(probe));
+    }
+}